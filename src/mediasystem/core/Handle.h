@@ -9,7 +9,17 @@
 
 #include <memory>
 
-//std:: shared & weak ptr
+//Handles are std::shared_ptr & std::weak_ptr by default. Define project wide:
+//MS_INTRUSIVE_HANDLES      use the single allocation handles from IntrusiveHandle.hpp instead
+//MS_NON_ATOMIC_HANDLES     with MS_INTRUSIVE_HANDLES, plain integer ref counts for apps that never share handles across threads
+
+#if defined(MS_NON_ATOMIC_HANDLES) && !defined(MS_INTRUSIVE_HANDLES)
+#error "MS_NON_ATOMIC_HANDLES requires MS_INTRUSIVE_HANDLES"
+#endif
+
+#if defined(MS_INTRUSIVE_HANDLES)
+#include "IntrusiveHandle.hpp"
+#endif
 
 namespace mediasystem {
     
@@ -79,6 +89,16 @@ namespace mediasystem {
     
     /////STRONGS AND HANDLES
     
+#if defined(MS_INTRUSIVE_HANDLES)
+    
+    template<typename T>
+    using StrongHandle = IntrusiveStrongHandle<T>;
+    
+    template<typename T>
+    using Handle = IntrusiveHandle<T>;
+    
+#else
+    
     //needs to be implicitly convertable to bool and keep the pointed to object alive in a ref counted way
     template<typename T>
     using StrongHandle = std::shared_ptr<T>;
@@ -88,6 +108,8 @@ namespace mediasystem {
     template<typename T>
     using Handle = weak_ptr_handle_adapter<T>;
     
+#endif
+    
     namespace detail {
     
         template<typename T, typename U, template <typename> class ptr>
@@ -114,6 +136,50 @@ namespace mediasystem {
             static Handle<T> reinterpretCast( const Handle<U>& r ) noexcept;
         };
         
+#if defined(MS_INTRUSIVE_HANDLES)
+        
+        template<typename T, typename U>
+        StrongHandle<T> cast<T,U,StrongHandle>::dynamicCast( const StrongHandle<U>& r ) noexcept {
+            return dynamic_handle_cast<T>(r);
+        }
+        
+        template<typename T, typename U>
+        StrongHandle<T> cast<T,U,StrongHandle>::staticCast( const StrongHandle<U>& r ) noexcept {
+            return static_handle_cast<T>(r);
+        }
+        
+        template<typename T, typename U>
+        StrongHandle<T> cast<T,U,StrongHandle>::constCast( const StrongHandle<U>& r ) noexcept {
+            return const_handle_cast<T>(r);
+        }
+        
+        template<typename T, typename U>
+        StrongHandle<T> cast<T,U,StrongHandle>::reinterpretCast( const StrongHandle<U>& r ) noexcept {
+            return reinterpret_handle_cast<T>(r);
+        }
+        
+        template<typename T, typename U>
+        Handle<T> cast<T,U,Handle>::dynamicCast( const Handle<U>& r ) noexcept {
+            return dynamic_handle_cast<T>(r.lock());
+        }
+        
+        template<typename T, typename U>
+        Handle<T> cast<T,U,Handle>::staticCast( const Handle<U>& r ) noexcept {
+            return static_handle_cast<T>(r.lock());
+        }
+        
+        template<typename T, typename U>
+        Handle<T> cast<T,U,Handle>::constCast( const Handle<U>& r ) noexcept {
+            return const_handle_cast<T>(r.lock());
+        }
+        
+        template<typename T, typename U>
+        Handle<T> cast<T,U,Handle>::reinterpretCast( const Handle<U>& r ) noexcept {
+            return reinterpret_handle_cast<T>(r.lock());
+        }
+        
+#else
+        
         template<typename T, typename U>
         StrongHandle<T> cast<T,U,StrongHandle>::dynamicCast( const StrongHandle<U>& r ) noexcept {
             return std::dynamic_pointer_cast<T>(r);
@@ -153,10 +219,26 @@ namespace mediasystem {
         Handle<T> cast<T,U,Handle>::reinterpretCast( const Handle<U>& r ) noexcept {
             return reinterpret_weak_pointer_cast<T>(r);
         }
+        
+#endif
        
     }//end namspace detail
     
     
+#if defined(MS_INTRUSIVE_HANDLES)
+    
+    template<typename T, typename...Args>
+    inline StrongHandle<T> makeStrongHandle( Args&&...args ){
+        return makeIntrusiveHandle<T>( std::forward<Args>(args)... );
+    }
+    
+    template<typename T, typename Alloc, typename...Args>
+    inline StrongHandle<T> allocateStrongHandle( Alloc&& alloc, Args&&...args ){
+        return allocateIntrusiveHandle<T>( std::forward<Alloc>(alloc), std::forward<Args>(args)... );
+    }
+    
+#else
+    
     template<typename T, typename...Args>
     inline StrongHandle<T> makeStrongHandle( Args&&...args ){
         return std::make_shared<T>( std::forward<Args>(args)... );
@@ -167,6 +249,8 @@ namespace mediasystem {
         return std::allocate_shared<T>( std::forward<Alloc>(alloc), std::forward<Args>(args)... );
     }
     
+#endif
+    
     template<typename T, typename U>
     inline StrongHandle<T> staticCast( const StrongHandle<U>& ptr ) noexcept {
         return detail::cast<T,U,StrongHandle>::staticCast(ptr);
@@ -0,0 +1,399 @@
+//
+//  IntrusiveHandle.hpp
+//  ofxMediaSystem
+//
+//  Ref counted strong and weak handles with the counts stored in a header at the front of the
+//  same allocation as the object. A strong handle is the object pointer plus the header pointer,
+//  there is no separate control block and no virtual dispatch, destruction goes through a single
+//  function pointer stored in the header. Defining MS_NON_ATOMIC_HANDLES turns the counts into
+//  plain integers, only do that when handles never cross threads.
+//  Selected in place of std::shared_ptr/std::weak_ptr by defining MS_INTRUSIVE_HANDLES, see Handle.h.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+namespace mediasystem {
+
+    namespace detail {
+
+#if defined(MS_NON_ATOMIC_HANDLES)
+
+        class HandleRefCount {
+        public:
+            explicit HandleRefCount(uint32_t count) noexcept : mCount(count){}
+            inline void increment() noexcept { ++mCount; }
+            //true when this dropped the last reference
+            inline bool decrement() noexcept { return --mCount == 0; }
+            inline bool incrementIfNotZero() noexcept {
+                if(mCount == 0)
+                    return false;
+                ++mCount;
+                return true;
+            }
+            inline uint32_t load() const noexcept { return mCount; }
+        private:
+            uint32_t mCount;
+        };
+
+#else
+
+        class HandleRefCount {
+        public:
+            explicit HandleRefCount(uint32_t count) noexcept : mCount(count){}
+            inline void increment() noexcept { mCount.fetch_add(1, std::memory_order_relaxed); }
+            //true when this dropped the last reference, acquire so the destroying thread sees every prior write
+            inline bool decrement() noexcept { return mCount.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+            inline bool incrementIfNotZero() noexcept {
+                auto count = mCount.load(std::memory_order_relaxed);
+                while(count != 0){
+                    if(mCount.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                        return true;
+                }
+                return false;
+            }
+            inline uint32_t load() const noexcept { return mCount.load(std::memory_order_acquire); }
+        private:
+            std::atomic<uint32_t> mCount;
+        };
+
+#endif
+
+        enum class HandleOp {
+            DESTROY_OBJECT,
+            RELEASE_MEMORY
+        };
+
+        class HandleHeader {
+        public:
+
+            using Manage = void(*)(HandleHeader*, HandleOp) noexcept;
+
+            explicit HandleHeader(Manage manage) noexcept : mManage(manage){}
+
+            inline void retain() noexcept { mStrong.increment(); }
+            inline bool tryRetain() noexcept { return mStrong.incrementIfNotZero(); }
+            inline void release() noexcept {
+                if(mStrong.decrement()){
+                    mManage(this, HandleOp::DESTROY_OBJECT);
+                    releaseWeak();
+                }
+            }
+
+            inline void retainWeak() noexcept { mWeak.increment(); }
+            inline void releaseWeak() noexcept {
+                if(mWeak.decrement())
+                    mManage(this, HandleOp::RELEASE_MEMORY);
+            }
+
+            inline long useCount() const noexcept { return static_cast<long>(mStrong.load()); }
+
+        private:
+            HandleRefCount mStrong{1};
+            //all strong handles together hold one weak reference, the memory goes when this hits zero
+            HandleRefCount mWeak{1};
+            Manage mManage;
+        };
+
+        template<typename T, typename Alloc>
+        class HandleBlock final : public HandleHeader {
+        public:
+
+            using BlockAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<HandleBlock>;
+            using BlockAllocatorTraits = std::allocator_traits<BlockAllocator>;
+
+            explicit HandleBlock(BlockAllocator alloc) noexcept : HandleHeader(&manage), mAlloc(std::move(alloc)){}
+
+            inline T* object() noexcept { return reinterpret_cast<T*>(&mStorage); }
+            inline void* storage() noexcept { return &mStorage; }
+
+            static void manage(HandleHeader* header, HandleOp op) noexcept {
+                auto block = static_cast<HandleBlock*>(header);
+                if(op == HandleOp::DESTROY_OBJECT){
+                    block->object()->~T();
+                }else{
+                    BlockAllocator alloc(std::move(block->mAlloc));
+                    block->~HandleBlock();
+                    BlockAllocatorTraits::deallocate(alloc, block, 1);
+                }
+            }
+
+        private:
+            BlockAllocator mAlloc;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type mStorage;
+        };
+
+    }//end namespace detail
+
+    template<typename T>
+    class IntrusiveHandle;
+
+    template<typename T>
+    class IntrusiveStrongHandle {
+    public:
+
+        using element_type = T;
+
+        constexpr IntrusiveStrongHandle() noexcept = default;
+        constexpr IntrusiveStrongHandle(std::nullptr_t) noexcept {}
+
+        IntrusiveStrongHandle(const IntrusiveStrongHandle& other) noexcept : mPtr(other.mPtr), mHeader(other.mHeader) {
+            if(mHeader)
+                mHeader->retain();
+        }
+
+        IntrusiveStrongHandle(IntrusiveStrongHandle&& other) noexcept : mPtr(other.mPtr), mHeader(other.mHeader) {
+            other.mPtr = nullptr;
+            other.mHeader = nullptr;
+        }
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        IntrusiveStrongHandle(const IntrusiveStrongHandle<U>& other) noexcept : mPtr(other.mPtr), mHeader(other.mHeader) {
+            if(mHeader)
+                mHeader->retain();
+        }
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        IntrusiveStrongHandle(IntrusiveStrongHandle<U>&& other) noexcept : mPtr(other.mPtr), mHeader(other.mHeader) {
+            other.mPtr = nullptr;
+            other.mHeader = nullptr;
+        }
+
+        //shares ownership with other but points at ptr, used by the casts
+        template<typename U>
+        IntrusiveStrongHandle(const IntrusiveStrongHandle<U>& other, T* ptr) noexcept : mPtr(ptr), mHeader(other.mHeader) {
+            if(mHeader)
+                mHeader->retain();
+        }
+
+        template<typename U>
+        IntrusiveStrongHandle(IntrusiveStrongHandle<U>&& other, T* ptr) noexcept : mPtr(ptr), mHeader(other.mHeader) {
+            other.mPtr = nullptr;
+            other.mHeader = nullptr;
+        }
+
+        ~IntrusiveStrongHandle() {
+            if(mHeader)
+                mHeader->release();
+        }
+
+        IntrusiveStrongHandle& operator=(const IntrusiveStrongHandle& other) noexcept {
+            IntrusiveStrongHandle(other).swap(*this);
+            return *this;
+        }
+
+        IntrusiveStrongHandle& operator=(IntrusiveStrongHandle&& other) noexcept {
+            IntrusiveStrongHandle(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        template<typename U>
+        IntrusiveStrongHandle& operator=(const IntrusiveStrongHandle<U>& other) noexcept {
+            IntrusiveStrongHandle(other).swap(*this);
+            return *this;
+        }
+
+        template<typename U>
+        IntrusiveStrongHandle& operator=(IntrusiveStrongHandle<U>&& other) noexcept {
+            IntrusiveStrongHandle(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        IntrusiveStrongHandle& operator=(std::nullptr_t) noexcept {
+            reset();
+            return *this;
+        }
+
+        void reset() noexcept { IntrusiveStrongHandle().swap(*this); }
+
+        void swap(IntrusiveStrongHandle& other) noexcept {
+            std::swap(mPtr, other.mPtr);
+            std::swap(mHeader, other.mHeader);
+        }
+
+        inline T* get() const noexcept { return mPtr; }
+        inline T* operator->() const noexcept { return mPtr; }
+
+        template<typename U = T, typename = typename std::enable_if<!std::is_void<U>::value>::type>
+        inline U& operator*() const noexcept { return *mPtr; }
+
+        explicit operator bool() const noexcept { return mPtr != nullptr; }
+
+        long use_count() const noexcept { return mHeader ? mHeader->useCount() : 0; }
+
+    private:
+
+        //takes over a reference the caller already holds
+        IntrusiveStrongHandle(T* ptr, detail::HandleHeader* header) noexcept : mPtr(ptr), mHeader(header) {}
+
+        T* mPtr{nullptr};
+        detail::HandleHeader* mHeader{nullptr};
+
+        template<typename> friend class IntrusiveStrongHandle;
+        template<typename> friend class IntrusiveHandle;
+        template<typename U, typename Alloc, typename...Args>
+        friend IntrusiveStrongHandle<U> allocateIntrusiveHandle( Alloc&& alloc, Args&&...args );
+    };
+
+    //non owning, lock() to get a strong handle while the object is still alive
+    template<typename T>
+    class IntrusiveHandle {
+    public:
+
+        using element_type = T;
+
+        constexpr IntrusiveHandle() noexcept = default;
+        constexpr IntrusiveHandle(std::nullptr_t) noexcept {}
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        IntrusiveHandle(const IntrusiveStrongHandle<U>& strong) noexcept : mPtr(strong.mPtr), mHeader(strong.mHeader) {
+            if(mHeader)
+                mHeader->retainWeak();
+        }
+
+        IntrusiveHandle(const IntrusiveHandle& other) noexcept : mPtr(other.mPtr), mHeader(other.mHeader) {
+            if(mHeader)
+                mHeader->retainWeak();
+        }
+
+        IntrusiveHandle(IntrusiveHandle&& other) noexcept : mPtr(other.mPtr), mHeader(other.mHeader) {
+            other.mPtr = nullptr;
+            other.mHeader = nullptr;
+        }
+
+        //goes through lock() so the pointer adjustment never touches a destroyed object
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        IntrusiveHandle(const IntrusiveHandle<U>& other) noexcept : IntrusiveHandle(other.lock()) {}
+
+        ~IntrusiveHandle() {
+            if(mHeader)
+                mHeader->releaseWeak();
+        }
+
+        IntrusiveHandle& operator=(const IntrusiveHandle& other) noexcept {
+            IntrusiveHandle(other).swap(*this);
+            return *this;
+        }
+
+        IntrusiveHandle& operator=(IntrusiveHandle&& other) noexcept {
+            IntrusiveHandle(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        template<typename U>
+        IntrusiveHandle& operator=(const IntrusiveStrongHandle<U>& strong) noexcept {
+            IntrusiveHandle(strong).swap(*this);
+            return *this;
+        }
+
+        void reset() noexcept { IntrusiveHandle().swap(*this); }
+
+        void swap(IntrusiveHandle& other) noexcept {
+            std::swap(mPtr, other.mPtr);
+            std::swap(mHeader, other.mHeader);
+        }
+
+        IntrusiveStrongHandle<T> lock() const noexcept {
+            if(mHeader && mHeader->tryRetain())
+                return IntrusiveStrongHandle<T>(mPtr, mHeader);
+            return IntrusiveStrongHandle<T>();
+        }
+
+        bool expired() const noexcept { return !mHeader || mHeader->useCount() == 0; }
+        long use_count() const noexcept { return mHeader ? mHeader->useCount() : 0; }
+
+        //de-reference access to a strong, same as the std adapter
+        IntrusiveStrongHandle<T> operator*() const noexcept { return lock(); }
+
+        //convertable to bool
+        operator bool() const noexcept { return !expired(); }
+
+        //same object, regardless of whether it is still alive
+        template<typename U>
+        bool owner_equals(const IntrusiveHandle<U>& other) const noexcept { return mHeader == other.mHeader; }
+
+    private:
+        T* mPtr{nullptr};
+        detail::HandleHeader* mHeader{nullptr};
+
+        template<typename> friend class IntrusiveHandle;
+    };
+
+    template<typename T, typename Alloc, typename...Args>
+    IntrusiveStrongHandle<T> allocateIntrusiveHandle( Alloc&& alloc, Args&&...args ){
+        using Block = detail::HandleBlock<T, typename std::decay<Alloc>::type>;
+        using BlockAllocator = typename Block::BlockAllocator;
+        using BlockAllocatorTraits = typename Block::BlockAllocatorTraits;
+        BlockAllocator blockAlloc(alloc);
+        auto block = BlockAllocatorTraits::allocate(blockAlloc, 1);
+        ::new(static_cast<void*>(block)) Block(blockAlloc);
+        try{
+            ::new(block->storage()) T(std::forward<Args>(args)...);
+        }catch(...){
+            block->~Block();
+            BlockAllocatorTraits::deallocate(blockAlloc, block, 1);
+            throw;
+        }
+        return IntrusiveStrongHandle<T>(block->object(), block);
+    }
+
+    template<typename T, typename...Args>
+    inline IntrusiveStrongHandle<T> makeIntrusiveHandle( Args&&...args ){
+        return allocateIntrusiveHandle<T>( std::allocator<T>(), std::forward<Args>(args)... );
+    }
+
+    template<typename T, typename U>
+    inline IntrusiveStrongHandle<T> static_handle_cast( const IntrusiveStrongHandle<U>& r ) noexcept {
+        return IntrusiveStrongHandle<T>(r, static_cast<T*>(r.get()));
+    }
+
+    template<typename T, typename U>
+    inline IntrusiveStrongHandle<T> dynamic_handle_cast( const IntrusiveStrongHandle<U>& r ) noexcept {
+        if(auto ptr = dynamic_cast<T*>(r.get()))
+            return IntrusiveStrongHandle<T>(r, ptr);
+        return IntrusiveStrongHandle<T>();
+    }
+
+    template<typename T, typename U>
+    inline IntrusiveStrongHandle<T> const_handle_cast( const IntrusiveStrongHandle<U>& r ) noexcept {
+        return IntrusiveStrongHandle<T>(r, const_cast<T*>(r.get()));
+    }
+
+    template<typename T, typename U>
+    inline IntrusiveStrongHandle<T> reinterpret_handle_cast( const IntrusiveStrongHandle<U>& r ) noexcept {
+        return IntrusiveStrongHandle<T>(r, reinterpret_cast<T*>(r.get()));
+    }
+
+    template<typename T, typename U>
+    inline bool operator==(const IntrusiveStrongHandle<T>& a, const IntrusiveStrongHandle<U>& b) noexcept { return a.get() == b.get(); }
+    template<typename T, typename U>
+    inline bool operator!=(const IntrusiveStrongHandle<T>& a, const IntrusiveStrongHandle<U>& b) noexcept { return a.get() != b.get(); }
+    template<typename T, typename U>
+    inline bool operator<(const IntrusiveStrongHandle<T>& a, const IntrusiveStrongHandle<U>& b) noexcept {
+        return std::less<const void*>()(a.get(), b.get());
+    }
+    template<typename T>
+    inline bool operator==(const IntrusiveStrongHandle<T>& a, std::nullptr_t) noexcept { return !a; }
+    template<typename T>
+    inline bool operator==(std::nullptr_t, const IntrusiveStrongHandle<T>& a) noexcept { return !a; }
+    template<typename T>
+    inline bool operator!=(const IntrusiveStrongHandle<T>& a, std::nullptr_t) noexcept { return static_cast<bool>(a); }
+    template<typename T>
+    inline bool operator!=(std::nullptr_t, const IntrusiveStrongHandle<T>& a) noexcept { return static_cast<bool>(a); }
+
+}//end namespace mediasystem
+
+namespace std {
+    template<typename T>
+    struct hash<mediasystem::IntrusiveStrongHandle<T>> {
+        size_t operator()(const mediasystem::IntrusiveStrongHandle<T>& handle) const noexcept {
+            return hash<T*>()(handle.get());
+        }
+    };
+}
@@ -7,11 +7,35 @@ namespace mediasystem {
     Scene::Scene(const std::string & name, AllocationManager&& allocationManager):
         mName(name),
         mAllocationManager(std::move(allocationManager))
-    {}
+    {
+        //scene changes must not wait behind bulk traffic when a dequeue budget is set
+        setEventPriority<SceneChange>(EventPriority::CRITICAL);
+    }
 
     Scene::~Scene()
     {}
     
+    AllocationReport Scene::getAllocationReport() const
+    {
+        auto report = mAllocationManager.report();
+        report.name = mName;
+        return report;
+    }
+    
+    AllocationLeakReport Scene::getLeakReport() const
+    {
+        auto report = mAllocationManager.reportLeaks();
+        report.name = mName;
+        return report;
+    }
+    
+    static Scene::LeakHandler sLeakHandler;
+    
+    void Scene::setLeakHandler(LeakHandler handler)
+    {
+        sLeakHandler = std::move(handler);
+    }
+    
     static size_t sNextEntityId = 0;
     
     EntityHandle Scene::createEntity()
@@ -168,15 +192,21 @@ namespace mediasystem {
             }
         }
         
+#if MS_HAS_COROUTINES
+        mScripts.update(elapsedTime);
+#endif
+        
         if(mIsTransitioning){
             auto perc = getPercentTransitionComplete();
             if(perc >= 1.){
                 switch(mTransitionDirection){
                     case TRANSITION_IN:
                         notifyTransitionInComplete();
+                        mFrameAllocationManager.resetArenas();
                         return;
                     case TRANSITION_OUT:
                         notifyTransitionOutComplete();
+                        mFrameAllocationManager.resetArenas();
                         return;
                 }
             }else{
@@ -190,6 +220,7 @@ namespace mediasystem {
         //process any events queued by other systems and components, etc.
         processEvents();
         collectEntities();
+        mFrameAllocationManager.resetArenas();
     }
     
     void Scene::notifyStart()
@@ -203,6 +234,9 @@ namespace mediasystem {
     {
         mStagedCues.clear();
         mCues.clear();
+#if MS_HAS_COROUTINES
+        mScripts.cancelAll();
+#endif
         mHasStarted = false;
         mIsTransitioning = false;
         stop();
@@ -246,8 +280,12 @@ namespace mediasystem {
     
     void Scene::notifyShutdown()
     {
+        cancelAsyncDelegates();
         mStagedCues.clear();
         mCues.clear();
+#if MS_HAS_COROUTINES
+        mScripts.cancelAll();
+#endif
         shutdown();
         triggerEvent<Shutdown>(*this);
         for(auto & ent : mEntities){
@@ -258,12 +296,22 @@ namespace mediasystem {
         clearSystems();
         clearQueues();
         clearDelegates();
+#if defined(MS_ALLOW_LEAK_TRACKING)
+        //whatever is left is held from outside the scene, e.g. handles captured in lambdas
+        auto leaks = getLeakReport();
+        if(!leaks.empty()){
+            MS_LOG_WARNING(leaks.toString());
+            if(sLeakHandler)
+                sLeakHandler(leaks);
+        }
+#endif
     }
     
     void Scene::notifyDraw()
     {
         draw();
         triggerEvent<Draw>(*this);
+        mFrameAllocationManager.resetArenas();
     }
     
     void Scene::notifyReset()
@@ -324,6 +372,7 @@ namespace mediasystem {
         auto id = sCueIds++;
         Cue c;
         c.interval = seconds;
+        c.repeats = true;
         c.executionTime = mCurrentTime + seconds;
         c.handler = std::move(handler);
         c.id = id;
@@ -350,4 +399,20 @@ namespace mediasystem {
         ofLogWarning("Scene") << "There is no Cue for id: " << id;
     }
     
+#if MS_HAS_COROUTINES
+    ScriptId Scene::startScript(SceneScript script)
+    {
+        return mScripts.start(std::move(script));
+    }
+    
+    void Scene::cancelScript(ScriptId id)
+    {
+        if(!mScripts.isRunning(id)){
+            ofLogWarning("Scene") << "There is no Script for id: " << id;
+            return;
+        }
+        mScripts.cancel(id);
+    }
+#endif
+    
 }//end namespace mediasystem
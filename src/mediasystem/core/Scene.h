@@ -5,7 +5,9 @@
 #include "mediasystem/events/EventManager.h"
 #include "mediasystem/events/SceneEvents.h"
 #include "mediasystem/util/StateMachine.h"
+#include "mediasystem/util/JobSystem.h"
 #include "mediasystem/core/Handle.h"
+#include "mediasystem/core/SceneScript.h"
 #include "mediasystem/memory/Memory.h"
 
 namespace mediasystem {
@@ -23,6 +25,14 @@ namespace mediasystem {
     
     using GenericComponentMap = std::map<size_t, detail::GenericStrongHandle, std::less<size_t>, detail::GenericStrongHandleAllocator>;
     
+    //Components Scene::compactComponents() is allowed to move to another address. Trivially copyable
+    //types qualify, others opt in with MS_RELOCATABLE_COMPONENT(Type) at global scope once moving them is safe.
+    template<typename T>
+    struct is_relocatable_component : std::is_trivially_copyable<T> {};
+    
+#define MS_RELOCATABLE_COMPONENT(Type) \
+    namespace mediasystem { template<> struct is_relocatable_component<Type> : std::true_type {}; }
+    
     //adapter class
     template<typename ComponentType>
     class ComponentMap {
@@ -45,13 +55,90 @@ namespace mediasystem {
             friend ComponentMap;
         };
         
+        //yields references the scene keeps alive, no handle is copied while walking the map
+        class borrowed_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = ComponentType;
+            using difference_type = std::ptrdiff_t;
+            using pointer = ComponentType*;
+            using reference = ComponentType&;
+            
+            borrowed_iterator() = default;
+            
+            reference operator*() const { return *static_cast<ComponentType*>(mIt->second.get()); }
+            pointer operator->() const { return static_cast<ComponentType*>(mIt->second.get()); }
+            borrowed_iterator& operator++(){ ++mIt; return *this; }
+            borrowed_iterator operator++(int){ auto prev = *this; ++mIt; return prev; }
+            bool operator==(const borrowed_iterator& other) const { return mIt == other.mIt; }
+            bool operator!=(const borrowed_iterator& other) const { return mIt != other.mIt; }
+            
+            inline size_t getEntityId() const { return mIt->first; }
+            
+        private:
+            explicit borrowed_iterator( GenericComponentMap::iterator it ):mIt(it){}
+            GenericComponentMap::iterator mIt;
+            friend ComponentMap;
+        };
+        
+        static constexpr size_t DEFAULT_PARALLEL_BATCH_SIZE = 64;
+        
         iterator iter(){ return mComponents ? iterator(mComponents->begin(), mComponents->end()) : iterator(); }
         size_t size() const { return mComponents ? mComponents->size() : 0; }
         bool empty() const { return mComponents ? mComponents->empty() : true; }
         
+        //for(auto& component : map), components of this type must not be created or destroyed inside the loop,
+        //that includes callbacks the loop body fires. Use iter() when a callback may remove the current component.
+        borrowed_iterator begin(){ return mComponents ? borrowed_iterator(mComponents->begin()) : borrowed_iterator(); }
+        borrowed_iterator end(){ return mComponents ? borrowed_iterator(mComponents->end()) : borrowed_iterator(); }
+        
+        //fn(ComponentType&) or fn(ComponentType&, size_t index), index counts up from 0 in map order
+        template<typename Fn>
+        void forEach(Fn&& fn){
+            if(!mComponents)
+                return;
+            size_t index = 0;
+            for(auto & generic : *mComponents){
+                invoke(fn, *static_cast<ComponentType*>(generic.second.get()), index++);
+            }
+        }
+        
+        //Same as forEach with the range split into batches across the scene's JobSystem, the calling
+        //thread works on batches too and returns once all of them are done. fn must be safe to run
+        //concurrently on different components, the index is the same one forEach would pass.
+        template<typename Fn>
+        void parallelForEach(Fn&& fn, size_t minBatchSize = DEFAULT_PARALLEL_BATCH_SIZE);
+        
+        template<typename Fn>
+        void parallelForEach(Fn&& fn, JobSystem& jobs, size_t minBatchSize = DEFAULT_PARALLEL_BATCH_SIZE){
+            if(!mComponents || mComponents->empty())
+                return;
+            std::vector<ComponentType*> components;
+            components.reserve(mComponents->size());
+            for(auto & generic : *mComponents){
+                components.push_back(static_cast<ComponentType*>(generic.second.get()));
+            }
+            jobs.parallelFor(components.size(), [&fn, &components](size_t begin, size_t end){
+                for(auto i = begin; i < end; i++){
+                    invoke(fn, *components[i], i);
+                }
+            }, minBatchSize);
+        }
+        
     private:
-        ComponentMap(GenericComponentMap* components):mComponents(components){}
+        ComponentMap(GenericComponentMap* components, Scene* scene):mComponents(components),mScene(scene){}
+        
+        template<typename Fn>
+        static void invoke(Fn& fn, ComponentType& component, size_t index){
+            if constexpr (std::is_invocable<Fn&, ComponentType&, size_t>::value){
+                fn(component, index);
+            }else{
+                fn(component);
+            }
+        }
+        
         GenericComponentMap* mComponents{nullptr};
+        Scene* mScene{nullptr};
         friend Scene;
     };
     
@@ -85,6 +172,11 @@ namespace mediasystem {
         
         inline const std::string& getName() const { return mName; }
         
+        //the DefaultJobSystem unless one was set, SceneManager shares it with every scene it owns.
+        //Async delegates run on the same jobs.
+        JobSystem& getJobSystem(){ return mJobSystem ? *mJobSystem : DefaultJobSystem::get(); }
+        void setJobSystem(JobSystem* jobSystem){ mJobSystem = jobSystem; setAsyncJobSystem(jobSystem); }
+        
         virtual EntityHandle createEntity();
         virtual bool destroyEntity(size_t id);
         virtual bool destroyEntity(EntityHandle handle);
@@ -217,15 +309,68 @@ namespace mediasystem {
         
         bool destroyComponent(type_id_t type, size_t entity_id);
         
+        //Repacks pooled components of this type towards the front of their storage and gives trailing blocks
+        //back to the pool. Only components the scene alone holds strongly are moved, each one that moves
+        //gets a fresh NewComponent event so systems caching weak handles pick up the new instance and
+        //drop the expired one. Any other cached Handle<ComponentType> expires. Returns the number moved.
+        template<typename ComponentType>
+        size_t compactComponents(){
+            static_assert(is_relocatable_component<ComponentType>::value, "Component type is not relocatable, see MS_RELOCATABLE_COMPONENT");
+            static_assert(std::is_move_constructible<ComponentType>::value && std::is_move_assignable<ComponentType>::value, "Relocatable components must be movable");
+            
+            auto found = mComponents.find(type_id<ComponentType>);
+            if(found == mComponents.end() || found->second.empty()){
+                return 0;
+            }
+            //every component of a type comes from the same policy, only that one is compacted
+            IAllocationPolicy* pool = mAllocationManager.findPolicy(found->second.begin()->second.get());
+            if(!pool){
+                return 0; //heap allocated, placement can't be steered
+            }
+            //sorts the free lists so replacements land in the lowest free slots
+            pool->compact();
+            
+            std::vector<std::pair<size_t, GenericComponentMap::iterator>> candidates;
+            for(auto it = found->second.begin(); it != found->second.end(); ++it){
+                if(it->second.use_count() == 1){
+                    candidates.emplace_back(pool->getStorageIndex(it->second.get()), it);
+                }
+            }
+            //highest first, each one takes the lowest free slot until the two meet
+            std::sort(candidates.begin(), candidates.end(), [](const std::pair<size_t, GenericComponentMap::iterator>& a, const std::pair<size_t, GenericComponentMap::iterator>& b){
+                return a.first > b.first;
+            });
+            
+            size_t moved = 0;
+            std::vector<detail::GenericStrongHandle> retired;
+            for(auto & candidate : candidates){
+                auto& current = *static_cast<ComponentType*>(candidate.second->second.get());
+                auto replacement = allocateStrongHandle<ComponentType>( getAllocator<ComponentType>(), std::move(current) );
+                auto index = pool->getStorageIndex(replacement.get());
+                if(index == IMemoryStorage::npos || index >= candidate.first){
+                    current = std::move(*replacement);
+                    break;
+                }
+                retired.push_back(std::move(candidate.second->second));
+                candidate.second->second = staticCast<void>(replacement);
+                queueEvent<NewComponent<ComponentType>>(getEntity(candidate.second->first), replacement);
+                ++moved;
+            }
+            retired.clear();
+            //the old slots are free now, sort again and release the tail
+            pool->compact();
+            return moved;
+        }
+        
         template<typename ComponentType>
         ComponentMap<ComponentType> getComponents(){
             auto found = mComponents.find(type_id<ComponentType>);
             if(found != mComponents.end()){
-                return ComponentMap<ComponentType>(&found->second);
+                return ComponentMap<ComponentType>(&found->second, this);
             }
             auto it = mComponents.emplace(type_id<ComponentType>, GenericComponentMap( getAllocator<std::pair<const size_t, detail::GenericStrongHandle>>() ));
             if(it.second){
-                return ComponentMap<ComponentType>(&it.first->second);
+                return ComponentMap<ComponentType>(&it.first->second, this);
             }else{
                 ofLogError("Scene") << ("ComponentManager: COULD NOT CREATE GENERIC COMPONENT MAP FOR COMPONENT TYPE");
                 return ComponentMap<ComponentType>();
@@ -249,11 +394,40 @@ namespace mediasystem {
             return Allocator<T>(&mAllocationManager, fmt);
         }
         
+        //scratch memory that is released at the end of every update and draw pass, main thread only.
+        //Nothing allocated here may outlive the pass, destructors are not run on reset.
+        template<typename T>
+        Allocator<T> getFrameAllocator(const AllocationPolicyFormat& fmt = AllocationPolicyFormat().frameArenaStrategy().blockListStorage(DEFAULT_FRAME_ARENA_BLOCK_SIZE)){
+            return Allocator<T>(&mFrameAllocationManager, fmt);
+        }
+        
+        static constexpr size_t DEFAULT_FRAME_ARENA_BLOCK_SIZE = 64 * 1024;
+        
+        //per type counters for every policy created with addStatsMiddleware(), named after the scene
+        AllocationReport getAllocationReport() const;
+        
+        //allocations still alive in policies with a LEAK_TRACKER, see AllocationManager::setLeakTracking()
+        AllocationLeakReport getLeakReport() const;
+        
+        //called from notifyShutdown when tracked allocations outlive the scene's components, systems and delegates.
+        //Leaks are logged regardless, tests can install a handler that fails. Never called without MS_ALLOW_LEAK_TRACKING.
+        using LeakHandler = std::function<void(const AllocationLeakReport&)>;
+        static void setLeakHandler(LeakHandler handler);
+        
         CueId cueAtTime(float seconds, std::function<void()> handler);
         CueId cueFromNow(float seconds, std::function<void()> handler);
         CueId cueInterval(float seconds, std::function<void()> handler);
         void cancelCue(CueId id);
         
+#if MS_HAS_COROUTINES
+        //runs the script up to its first co_await, then resumes it from notifyUpdate after the cues.
+        //Scripts are cancelled on stop and shutdown like cues, returns 0 if the script finished right away.
+        ScriptId startScript(SceneScript script);
+        void cancelScript(ScriptId id);
+        inline size_t getNumScripts() const { return mScripts.getNumScripts(); }
+        inline ScriptScheduler& getScriptScheduler(){ return mScripts; }
+#endif
+        
 	protected:
         
         virtual void init(){}
@@ -307,6 +481,8 @@ namespace mediasystem {
         std::deque<size_t> mDestroyedEntities;
         std::string mPreviousScene;
         StateMachine mSequence;
+        AllocationManager mFrameAllocationManager;
+        JobSystem* mJobSystem{nullptr};
         
         struct Cue {
             std::function<void()> handler;
@@ -319,7 +495,17 @@ namespace mediasystem {
         float mCurrentTime{0};
         std::list<Cue> mStagedCues;
         std::list<Cue> mCues;
+#if MS_HAS_COROUTINES
+        //declared after everything a script may hold so suspended scripts are destroyed first
+        ScriptScheduler mScripts;
+#endif
         friend class SceneManager;
 	};
     
+    template<typename ComponentType>
+    template<typename Fn>
+    void ComponentMap<ComponentType>::parallelForEach(Fn&& fn, size_t minBatchSize){
+        parallelForEach(std::forward<Fn>(fn), mScene ? mScene->getJobSystem() : DefaultJobSystem::get(), minBatchSize);
+    }
+    
 }//end namespace mediasystem
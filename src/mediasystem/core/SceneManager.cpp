@@ -14,11 +14,16 @@
 
 namespace mediasystem {
     
-    SceneManager::SceneManager()
+    SceneManager::SceneManager():
+        mJobSystem(DefaultJobSystem::get())
     {}
     
     SceneManager::~SceneManager()
-    {}
+    {
+        for(auto & scene : mScenes){
+            scene->setJobSystem(nullptr);
+        }
+    }
 
     void SceneManager::shutdownScenes()
     {
@@ -77,9 +82,41 @@ namespace mediasystem {
     void SceneManager::addScene(StrongHandle<Scene> scene)
     {
         scene->addDelegate<SceneChange>(EventDelegate::create<SceneManager, &SceneManager::onChangeScene>(this));
+        scene->setJobSystem(&mJobSystem);
         mScenes.emplace_back(std::move(scene));
     }
     
+    size_t SceneManager::broadcastEvent(const IEventRef& event)
+    {
+        syncEventBus();
+        return mEventBus.publish(event);
+    }
+    
+    void SceneManager::broadcastThreadedEvent(const IEventRef& event)
+    {
+        mEventBus.publishThreaded(event);
+    }
+    
+    void SceneManager::setBroadcastToInactiveScenes(bool broadcast)
+    {
+        mBroadcastToInactiveScenes = broadcast;
+        mEventBusDirty = true;
+    }
+    
+    void SceneManager::syncEventBus()
+    {
+        if(!mEventBusDirty && mEventBusCurrent == mCurrentScene.get() && mEventBusNext == mNextScene.get()){
+            return;
+        }
+        mEventBusCurrent = mCurrentScene.get();
+        mEventBusNext = mNextScene.get();
+        mEventBusDirty = false;
+        for(auto & scene : mScenes){
+            auto active = mBroadcastToInactiveScenes || scene == mCurrentScene || scene == mNextScene;
+            mEventBus.setReceiverEnabled(scene.get(), active);
+        }
+    }
+    
     EventStatus SceneManager::swapScenes(const IEventRef&)
     {
         MS_LOG_VERBOSE("Transitioning complete! swapping current and next");
@@ -150,7 +187,7 @@ namespace mediasystem {
         
         MS_LOG_VERBOSE("Received a scene change request...");
         
-        auto cast = staticCast<SceneChange>(sceneChange);
+        auto cast = std::static_pointer_cast<SceneChange>(sceneChange);
         if(cast->getNextScene()){
             changeSceneTo(cast->getNextScene(),cast->getDrawOrder());
         }else{
@@ -186,6 +223,11 @@ namespace mediasystem {
         
         auto dt = time - mPrevTime;
         
+        mJobSystem.processMainThreadJobs();
+        
+        syncEventBus();
+        mEventBus.processEvents();
+        
         if(mCurrentScene)
             mCurrentScene->notifyUpdate(framenum, time, dt);
         
@@ -206,10 +248,11 @@ namespace mediasystem {
 
     void SceneManager::destroyScene(const std::string& name)
     {
-        auto found = std::find_if(mScenes.begin(), mScenes.end(),[&name](const std::shared_ptr<Scene>& scene){
+        auto found = std::find_if(mScenes.begin(), mScenes.end(),[&name](const StrongHandle<Scene>& scene){
             return scene->getName() == name;
         });
         if(found != mScenes.end()){
+            mEventBus.unsubscribeAll(found->get());
             mScenes.erase(found);
         }else{
             MS_LOG_ERROR("dont have a scene by the name: " + name);
@@ -220,6 +263,7 @@ namespace mediasystem {
     {
         auto found = std::find(mScenes.begin(), mScenes.end(), scene);
         if(found != mScenes.end()){
+            mEventBus.unsubscribeAll(scene.get());
             mScenes.erase(found);
         }else{
             MS_LOG_ERROR("dont have a scene by the name: " + scene->getName());
@@ -228,6 +272,7 @@ namespace mediasystem {
     
     void SceneManager::clear()
     {
+        mEventBus.clear();
         mScenes.clear();
         mNextScene = nullptr;
         mCurrentScene = nullptr;
@@ -4,6 +4,7 @@
 #include <memory>
 #include <map>
 #include "mediasystem/events/EventManager.h"
+#include "mediasystem/events/EventBus.h"
 #include "mediasystem/events/SceneEvents.h"
 #include "mediasystem/core/Scene.h"
 
@@ -33,6 +34,7 @@ namespace mediasystem {
         {
             static_assert(std::is_base_of<Scene,SceneType>::value, "SceneType must be derived from mediasystem::Scene");
             mScenes.emplace_back(makeStrongHandle<SceneType>(std::forward<Args>(args)...));
+            mScenes.back()->setJobSystem(&mJobSystem);
             mScenes.back()->addDelegate<SceneChange>(EventDelegate::create<SceneManager, &SceneManager::onChangeScene>(this));
             return staticCast<SceneType>(mScenes.back());
         }
@@ -50,13 +52,55 @@ namespace mediasystem {
         StrongHandle<Scene> getNextScene() const { return mNextScene; }
         StrongHandle<Scene> getScene(const std::string& name) const;
         std::vector<StrongHandle<Scene>>& getScenes(){ return mScenes; }
+        
+        //routes broadcast events of EventType to the scene when their topics intersect
+        template<typename EventType>
+        void subscribeScene(const StrongHandle<Scene>& scene, EventTopicMask topics = ALL_EVENT_TOPICS)
+        {
+            mEventBus.subscribe<EventType>(scene.get(), topics);
+            mEventBusDirty = true;
+        }
+        
+        template<typename EventType>
+        void unsubscribeScene(const StrongHandle<Scene>& scene)
+        {
+            mEventBus.unsubscribe<EventType>(scene.get());
+        }
+        
+        //queues the same event into every subscribed scene
+        size_t broadcastEvent(const IEventRef& event);
+        template<typename EventType, typename...Args>
+        size_t broadcastEvent(Args&&...args){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            return broadcastEvent(std::make_shared<EventType>(std::forward<Args>(args)...));
+        }
+        
+        //safe from any thread, routed at the start of the next update
+        void broadcastThreadedEvent(const IEventRef& event);
+        template<typename EventType, typename...Args>
+        void broadcastThreadedEvent(Args&&...args){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            broadcastThreadedEvent(std::make_shared<EventType>(std::forward<Args>(args)...));
+        }
+        
+        //by default only the current and next scene receive broadcasts, the others aren't processing events
+        void setBroadcastToInactiveScenes(bool broadcast);
+        bool getBroadcastToInactiveScenes() const { return mBroadcastToInactiveScenes; }
+        
+        EventBus& getEventBus(){ return mEventBus; }
+        
+        //the DefaultJobSystem, shared by every scene this manager owns. Main thread jobs run at the start of update()
+        JobSystem& getJobSystem(){ return mJobSystem; }
 
 	protected:
         
         EventStatus onChangeScene(const IEventRef& sceneChange);
 
         void transition();
+        void syncEventBus();
         EventStatus swapScenes(const IEventRef&);
+        //one pool for the whole app, image sequences and async delegates default to it as well
+        JobSystem& mJobSystem;
         float mPrevTime{0.f};
         bool mSetTime{false};
         StrongHandle<Scene> mNextScene{nullptr};
@@ -65,6 +109,11 @@ namespace mediasystem {
         StrongHandle<Scene> mTop{nullptr};
         StrongHandle<Scene> mBottom{nullptr};
         std::vector<StrongHandle<Scene>> mScenes;
+        EventBus mEventBus;
+        bool mBroadcastToInactiveScenes{false};
+        bool mEventBusDirty{true};
+        Scene* mEventBusCurrent{nullptr};
+        Scene* mEventBusNext{nullptr};
 	};
 
 }//end namespace pf
@@ -0,0 +1,227 @@
+//
+//  SceneScript.cpp
+//  ofxMediaSystem
+//
+
+#include "SceneScript.h"
+
+#if MS_HAS_COROUTINES
+
+#include <algorithm>
+#include "Scene.h"
+
+namespace mediasystem {
+
+    namespace detail {
+
+        //precedes every frame, remembers where the frame came from
+        struct alignas(std::max_align_t) ScriptFrameHeader {
+            Allocator<ScriptFrameBlock> allocator;
+            size_t numBlocks{0}; //0 for frames from the heap
+        };
+
+        static const size_t SCRIPT_FRAME_POOL_SIZE = 64 * 1024;
+
+        void* allocateScriptFrame(Scene* scene, size_t size)
+        {
+            auto total = sizeof(ScriptFrameHeader) + size;
+            if(!scene){
+                auto header = new(::operator new(total)) ScriptFrameHeader();
+                return header + 1;
+            }
+            //frame sizes vary per script, size classes keep them pooled
+            auto allocator = scene->getAllocator<ScriptFrameBlock>(AllocationPolicyFormat().sizeClassPoolStrategy().blockListStorage(SCRIPT_FRAME_POOL_SIZE));
+            auto numBlocks = (total + sizeof(ScriptFrameBlock) - 1) / sizeof(ScriptFrameBlock);
+            auto blocks = allocator.allocate(numBlocks);
+            if(!blocks)
+                throw std::bad_alloc();
+            auto header = new(blocks) ScriptFrameHeader{allocator, numBlocks};
+            return header + 1;
+        }
+
+        void deallocateScriptFrame(void* frame, size_t size)
+        {
+            auto header = static_cast<ScriptFrameHeader*>(frame) - 1;
+            if(!header->numBlocks){
+                header->~ScriptFrameHeader();
+                ::operator delete(header);
+                return;
+            }
+            auto allocator = header->allocator;
+            auto numBlocks = header->numBlocks;
+            header->~ScriptFrameHeader();
+            allocator.deallocate(reinterpret_cast<ScriptFrameBlock*>(header), numBlocks);
+        }
+
+    }//end namespace detail
+
+    ScriptScheduler::~ScriptScheduler()
+    {
+        cancelAll();
+    }
+
+    ScriptId ScriptScheduler::start(SceneScript script)
+    {
+        auto handle = script.release();
+        if(!handle)
+            return 0;
+        auto id = mNextId++;
+        auto& promise = handle.promise();
+        promise.mScheduler = this;
+        promise.mRootId = id;
+        mScripts.emplace(id, handle);
+        resume(Wait{0, handle});
+        return isRunning(id) ? id : 0;
+    }
+
+    void ScriptScheduler::cancel(ScriptId id)
+    {
+        if(std::find(mRunning.begin(), mRunning.end(), id) != mRunning.end()){
+            mDeferredCancels.push_back(id);
+            return;
+        }
+        auto found = mScripts.find(id);
+        if(found == mScripts.end())
+            return;
+        auto handle = found->second;
+        mScripts.erase(found);
+        //runs the destructors of everything the script holds, its waits forget themselves
+        handle.destroy();
+    }
+
+    void ScriptScheduler::cancelAll()
+    {
+        std::vector<ScriptId> ids;
+        ids.reserve(mScripts.size());
+        for(auto& script : mScripts){
+            ids.push_back(script.first);
+        }
+        for(auto id : ids){
+            cancel(id);
+        }
+        //only waits of scripts still on the call stack are left
+        if(mRunning.empty()){
+            mTimers = decltype(mTimers)();
+            mPolls.clear();
+            mReady.clear();
+            mForgotten.clear();
+        }
+    }
+
+    void ScriptScheduler::update(float time)
+    {
+        mTime = time;
+        //waits added from here on belong to the next update
+        auto firstNewTicket = mNextTicket;
+
+        std::vector<Timer> postponed;
+        while(!mTimers.empty() && mTimers.top().time <= time){
+            auto timer = mTimers.top();
+            mTimers.pop();
+            if(timer.wait.ticket >= firstNewTicket){
+                postponed.push_back(timer);
+                continue;
+            }
+            if(!isForgotten(timer.wait.ticket))
+                resume(timer.wait);
+        }
+        for(auto& timer : postponed){
+            mTimers.push(timer);
+        }
+
+        if(!mPolls.empty()){
+            auto polls = std::move(mPolls);
+            mPolls.clear();
+            for(auto& poll : polls){
+                //a forgotten condition may already be destroyed
+                if(isForgotten(poll.wait.ticket))
+                    continue;
+                if(poll.wait.ticket < firstNewTicket && (*poll.condition)())
+                    resume(poll.wait);
+                else
+                    mPolls.push_back(poll);
+            }
+        }
+
+        if(!mReady.empty()){
+            auto ready = std::move(mReady);
+            mReady.clear();
+            for(auto& wait : ready){
+                if(!isForgotten(wait.ticket))
+                    resume(wait);
+            }
+        }
+    }
+
+    ScriptTicket ScriptScheduler::sleepUntil(float time, SceneScript::Handle handle)
+    {
+        auto ticket = mNextTicket++;
+        mTimers.push(Timer{time, Wait{ticket, handle}});
+        return ticket;
+    }
+
+    ScriptTicket ScriptScheduler::resumeNextUpdate(SceneScript::Handle handle)
+    {
+        auto ticket = mNextTicket++;
+        mReady.push_back(Wait{ticket, handle});
+        return ticket;
+    }
+
+    ScriptTicket ScriptScheduler::pollUntil(const Condition* condition, SceneScript::Handle handle)
+    {
+        auto ticket = mNextTicket++;
+        mPolls.push_back(Poll{condition, Wait{ticket, handle}});
+        return ticket;
+    }
+
+    void ScriptScheduler::forget(ScriptTicket ticket)
+    {
+        mForgotten.insert(ticket);
+    }
+
+    bool ScriptScheduler::isForgotten(ScriptTicket ticket)
+    {
+        if(mForgotten.empty())
+            return false;
+        return mForgotten.erase(ticket) > 0;
+    }
+
+    void ScriptScheduler::resume(const Wait& wait)
+    {
+        auto id = wait.handle.promise().mRootId;
+        mRunning.push_back(id);
+        wait.handle.resume();
+        mRunning.pop_back();
+
+        auto found = mScripts.find(id);
+        if(found == mScripts.end())
+            return;
+        auto cancelled = std::find(mDeferredCancels.begin(), mDeferredCancels.end(), id);
+        if(cancelled != mDeferredCancels.end()){
+            mDeferredCancels.erase(cancelled);
+            cancel(id);
+        }else if(found->second.done()){
+            finish(id);
+        }
+    }
+
+    void ScriptScheduler::finish(ScriptId id)
+    {
+        auto found = mScripts.find(id);
+        auto handle = found->second;
+        mScripts.erase(found);
+        if(auto exception = handle.promise().mException){
+            try{
+                std::rethrow_exception(exception);
+            }catch(const std::exception& e){
+                ofLogError("SceneScript") << "Script " << id << " threw: " << e.what();
+            }catch(...){
+                ofLogError("SceneScript") << "Script " << id << " threw an unknown exception";
+            }
+        }
+        handle.destroy();
+    }
+
+}//end namespace mediasystem
+
+#endif
@@ -0,0 +1,425 @@
+//
+//  SceneScript.h
+//  ofxMediaSystem
+//
+//  Coroutine scripts for sequencing a scene without nesting cue and state callbacks. A script is a
+//  function returning SceneScript that co_awaits delays, events, playables or other scripts:
+//
+//      SceneScript intro(Scene& scene, StrongHandle<Animatable<float>> fade){
+//          co_await waitFor(2.f);
+//          fade->play();
+//          co_await waitForFinish(*fade);
+//          auto click = co_await waitForEvent<Click>(scene);
+//          co_await outro(scene);
+//      }
+//      scene.startScript(intro(scene, fade));
+//
+//  When the Scene is one of the script's parameters (or the second one for a member function or
+//  lambda) the coroutine frame is allocated from the Scene's AllocationManager, otherwise from the
+//  heap. Scripts are resumed by the scene's ScriptScheduler from notifyUpdate, on the main thread.
+//  Needs C++20 coroutines, MS_HAS_COROUTINES is 0 and this header is empty otherwise.
+//
+
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define MS_HAS_COROUTINES 1
+#else
+#define MS_HAS_COROUTINES 0
+#endif
+
+#if MS_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "mediasystem/events/EventManager.h"
+#include "mediasystem/memory/Memory.h"
+
+namespace mediasystem {
+
+    class Scene;
+    class ScriptScheduler;
+
+    using ScriptId = size_t;
+    using ScriptTicket = size_t;
+
+    namespace detail {
+
+        //coroutine frames are allocated in whole blocks so scripts of similar size share a size class
+        struct alignas(std::max_align_t) ScriptFrameBlock {
+            unsigned char bytes[64];
+        };
+
+        void* allocateScriptFrame(Scene* scene, size_t size);
+        void deallocateScriptFrame(void* frame, size_t size);
+
+    }
+
+    class SceneScript {
+    public:
+
+        struct promise_type;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        struct promise_type {
+
+            SceneScript get_return_object(){ return SceneScript(Handle::from_promise(*this)); }
+            //nothing runs until the script is started or awaited
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            struct FinalAwaiter {
+                bool await_ready() noexcept { return false; }
+                //a child hands control straight back to the script awaiting it, a root stays suspended for its scheduler to destroy
+                std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+                    if(auto continuation = handle.promise().mContinuation)
+                        return continuation;
+                    return std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            void return_void(){}
+            void unhandled_exception(){ mException = std::current_exception(); }
+
+            //frames for scripts taking the scene, or taking it right after the object or closure they belong to
+            template<typename...Args>
+            static void* operator new(size_t size, Scene& scene, Args&...){
+                return detail::allocateScriptFrame(&scene, size);
+            }
+            template<typename Owner, typename...Args, typename = std::enable_if_t<!std::is_base_of<Scene, Owner>::value>>
+            static void* operator new(size_t size, Owner&, Scene& scene, Args&...){
+                return detail::allocateScriptFrame(&scene, size);
+            }
+            static void* operator new(size_t size){
+                return detail::allocateScriptFrame(nullptr, size);
+            }
+            static void operator delete(void* frame, size_t size){
+                detail::deallocateScriptFrame(frame, size);
+            }
+
+            ScriptScheduler* mScheduler{nullptr};
+            std::coroutine_handle<> mContinuation;
+            std::exception_ptr mException;
+            ScriptId mRootId{0};
+        };
+
+        SceneScript() = default;
+        SceneScript(SceneScript&& other) noexcept : mHandle(other.mHandle) { other.mHandle = nullptr; }
+        SceneScript& operator=(SceneScript&& other) noexcept {
+            if(this != &other){
+                reset();
+                mHandle = other.mHandle;
+                other.mHandle = nullptr;
+            }
+            return *this;
+        }
+        ~SceneScript(){ reset(); }
+
+        //non copyable
+        SceneScript(const SceneScript&) = delete;
+        SceneScript& operator=(const SceneScript&) = delete;
+
+        explicit operator bool() const { return static_cast<bool>(mHandle); }
+
+        //runs the script as part of the awaiting one, exceptions it throws are rethrown to the caller
+        auto operator co_await() && noexcept {
+            struct ChildAwaiter {
+                Handle child;
+                bool await_ready() const noexcept { return !child || child.done(); }
+                std::coroutine_handle<> await_suspend(Handle parent) noexcept {
+                    auto& promise = child.promise();
+                    promise.mScheduler = parent.promise().mScheduler;
+                    promise.mRootId = parent.promise().mRootId;
+                    promise.mContinuation = parent;
+                    return child;
+                }
+                void await_resume(){
+                    if(child && child.promise().mException)
+                        std::rethrow_exception(child.promise().mException);
+                }
+            };
+            return ChildAwaiter{mHandle};
+        }
+
+    private:
+
+        explicit SceneScript(Handle handle):mHandle(handle){}
+
+        void reset(){
+            if(mHandle){
+                mHandle.destroy();
+                mHandle = nullptr;
+            }
+        }
+
+        Handle release(){
+            auto handle = mHandle;
+            mHandle = nullptr;
+            return handle;
+        }
+
+        Handle mHandle;
+        friend ScriptScheduler;
+    };
+
+    //Owns started scripts and resumes them from update(). Timers live in a heap ordered by wake time so a
+    //frame only touches the scripts that are due. Anything a script starts waiting on while the scheduler
+    //is updating is first checked on the next update. Main thread only.
+    class ScriptScheduler {
+    public:
+
+        using Condition = std::function<bool()>;
+
+        ScriptScheduler() = default;
+        //destroys every script that hasn't finished
+        ~ScriptScheduler();
+
+        //non copyable
+        ScriptScheduler(const ScriptScheduler&) = delete;
+        ScriptScheduler& operator=(const ScriptScheduler&) = delete;
+
+        //runs the script up to its first co_await, returns 0 if it finished right away
+        ScriptId start(SceneScript script);
+        //destroys the script wherever it is suspended, a script cancelling itself stops at its next co_await
+        void cancel(ScriptId id);
+        void cancelAll();
+
+        void update(float time);
+
+        inline float getTime() const { return mTime; }
+        inline size_t getNumScripts() const { return mScripts.size(); }
+        bool isRunning(ScriptId id) const { return mScripts.count(id) > 0; }
+
+        /////used by the awaitables, each returns the ticket to forget() if the wait is abandoned
+
+        ScriptTicket sleepUntil(float time, SceneScript::Handle handle);
+        ScriptTicket resumeNextUpdate(SceneScript::Handle handle);
+        //condition must stay valid until the wait is resumed or forgotten
+        ScriptTicket pollUntil(const Condition* condition, SceneScript::Handle handle);
+        void forget(ScriptTicket ticket);
+
+    private:
+
+        struct Wait {
+            ScriptTicket ticket;
+            SceneScript::Handle handle;
+        };
+
+        struct Timer {
+            float time;
+            Wait wait;
+            bool operator>(const Timer& other) const {
+                return time > other.time || (time == other.time && wait.ticket > other.wait.ticket);
+            }
+        };
+
+        struct Poll {
+            const Condition* condition;
+            Wait wait;
+        };
+
+        //true, and clears the ticket, if the wait was abandoned
+        bool isForgotten(ScriptTicket ticket);
+        void resume(const Wait& wait);
+        void finish(ScriptId id);
+
+        float mTime{0.f};
+        ScriptId mNextId{1};
+        ScriptTicket mNextTicket{1};
+        std::unordered_map<ScriptId, SceneScript::Handle> mScripts;
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> mTimers;
+        std::vector<Poll> mPolls;
+        std::vector<Wait> mReady;
+        std::unordered_set<ScriptTicket> mForgotten;
+        //scripts on the call stack can't be destroyed until they suspend
+        std::vector<ScriptId> mRunning;
+        std::vector<ScriptId> mDeferredCancels;
+    };
+
+    namespace detail {
+
+        //forgets the pending wait if the script is destroyed while suspended on it
+        struct ScriptWait {
+            ScriptWait() = default;
+            ScriptWait(const ScriptWait&) = delete;
+            ScriptWait& operator=(const ScriptWait&) = delete;
+            ~ScriptWait(){
+                if(scheduler && ticket && !resumed)
+                    scheduler->forget(ticket);
+            }
+            ScriptScheduler* scheduler{nullptr};
+            ScriptTicket ticket{0};
+            bool resumed{false};
+        };
+
+        struct SleepAwaiter : ScriptWait {
+            explicit SleepAwaiter(float t, bool absolute):time(t),absolute(absolute){}
+            bool await_ready() const noexcept { return !absolute && time <= 0.f; }
+            void await_suspend(SceneScript::Handle handle){
+                scheduler = handle.promise().mScheduler;
+                ticket = scheduler->sleepUntil(absolute ? time : scheduler->getTime() + time, handle);
+            }
+            void await_resume() noexcept { resumed = true; }
+            float time;
+            bool absolute;
+        };
+
+        struct NextFrameAwaiter : ScriptWait {
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(SceneScript::Handle handle){
+                scheduler = handle.promise().mScheduler;
+                ticket = scheduler->resumeNextUpdate(handle);
+            }
+            void await_resume() noexcept { resumed = true; }
+        };
+
+        struct ConditionAwaiter : ScriptWait {
+            explicit ConditionAwaiter(ScriptScheduler::Condition c):condition(std::move(c)){}
+            bool await_ready(){ return condition(); }
+            void await_suspend(SceneScript::Handle handle){
+                scheduler = handle.promise().mScheduler;
+                ticket = scheduler->pollUntil(&condition, handle);
+            }
+            void await_resume() noexcept { resumed = true; }
+            ScriptScheduler::Condition condition;
+        };
+
+        template<typename EventType>
+        struct EventAwaiter : ScriptWait {
+
+            using Filter = std::function<bool(const EventType&)>;
+
+            EventAwaiter(EventManager& manager, Filter filter, EventTopicMask topics):
+                manager(manager),
+                filter(std::move(filter)),
+                topics(topics)
+            {}
+
+            ~EventAwaiter(){
+                if(registered)
+                    manager.removeDelegate<EventType>(EventDelegate::create<EventAwaiter, &EventAwaiter::onEvent>(this));
+            }
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(SceneScript::Handle h){
+                handle = h;
+                scheduler = h.promise().mScheduler;
+                manager.addDelegate<EventType>(EventDelegate::create<EventAwaiter, &EventAwaiter::onEvent>(this), topics);
+                registered = true;
+            }
+            std::shared_ptr<EventType> await_resume() noexcept {
+                resumed = true;
+                return std::move(event);
+            }
+
+            //the script resumes on the next update rather than in the middle of dispatch
+            EventStatus onEvent(const IEventRef& received){
+                auto cast = std::static_pointer_cast<EventType>(received);
+                if(filter && !filter(*cast))
+                    return EventStatus::SUCCESS;
+                event = std::move(cast);
+                registered = false;
+                ticket = scheduler->resumeNextUpdate(handle);
+                return EventStatus::REMOVE_THIS_DELEGATE;
+            }
+
+            EventManager& manager;
+            Filter filter;
+            EventTopicMask topics;
+            SceneScript::Handle handle;
+            std::shared_ptr<EventType> event;
+            bool registered{false};
+        };
+
+        //disarmed after the first firing so a fast loop can't resume the script twice before the keyframe is removed
+        struct KeyFrameWait {
+            ScriptScheduler* scheduler{nullptr};
+            SceneScript::Handle handle;
+            ScriptTicket ticket{0};
+            bool armed{false};
+        };
+
+        template<typename PlayableType, typename Position>
+        struct KeyFrameAwaiter {
+
+            KeyFrameAwaiter(PlayableType& playable, Position position):
+                playable(playable),
+                position(position),
+                wait(std::make_shared<KeyFrameWait>())
+            {}
+
+            KeyFrameAwaiter(const KeyFrameAwaiter&) = delete;
+            KeyFrameAwaiter& operator=(const KeyFrameAwaiter&) = delete;
+
+            ~KeyFrameAwaiter(){
+                wait->armed = false;
+                if(keyFrame)
+                    playable.removeKeyFrame(keyFrame);
+                if(wait->ticket && !resumed)
+                    wait->scheduler->forget(wait->ticket);
+            }
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(SceneScript::Handle handle){
+                wait->scheduler = handle.promise().mScheduler;
+                wait->handle = handle;
+                wait->armed = true;
+                keyFrame = playable.setKeyFrame(position, [wait = wait](auto&){
+                    if(!wait->armed)
+                        return;
+                    wait->armed = false;
+                    wait->ticket = wait->scheduler->resumeNextUpdate(wait->handle);
+                });
+            }
+            void await_resume() noexcept { resumed = true; }
+
+            PlayableType& playable;
+            Position position;
+            std::shared_ptr<KeyFrameWait> wait;
+            size_t keyFrame{0};
+            bool resumed{false};
+        };
+
+    }//end namespace detail
+
+    /////awaitables, only valid inside a SceneScript
+
+    //resumes on the first update at least seconds from now
+    inline detail::SleepAwaiter waitFor(float seconds){ return detail::SleepAwaiter(seconds, false); }
+    //resumes on the first update at or after scene time seconds
+    inline detail::SleepAwaiter waitUntilTime(float seconds){ return detail::SleepAwaiter(seconds, true); }
+    inline detail::NextFrameAwaiter waitForNextFrame(){ return detail::NextFrameAwaiter(); }
+    //checked once per update, doesn't suspend if it already holds
+    inline detail::ConditionAwaiter waitUntil(ScriptScheduler::Condition condition){ return detail::ConditionAwaiter(std::move(condition)); }
+
+    //resumes on the update after the first matching EventType is dispatched by manager and yields the event
+    template<typename EventType>
+    detail::EventAwaiter<EventType> waitForEvent(EventManager& manager, std::function<bool(const EventType&)> filter = nullptr, EventTopicMask topics = ALL_EVENT_TOPICS){
+        static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+        return detail::EventAwaiter<EventType>(manager, std::move(filter), topics);
+    }
+
+    //any Playable, Animatable or ImageSequence, which has to outlive the wait
+    template<typename PlayableType>
+    detail::ConditionAwaiter waitForFinish(PlayableType& playable){
+        return detail::ConditionAwaiter([&playable]{ return playable.isFinished(); });
+    }
+
+    //resumes on the update after playback reaches position, the keyframe it adds is removed again once the wait ends.
+    //The playable has to outlive the wait.
+    template<typename PlayableType, typename Position>
+    detail::KeyFrameAwaiter<PlayableType, Position> waitForKeyFrame(PlayableType& playable, Position position){
+        return detail::KeyFrameAwaiter<PlayableType, Position>(playable, position);
+    }
+
+}//end namespace mediasystem
+
+#endif
@@ -16,6 +16,7 @@
 */
 
 #pragma once
+#include <cstdint>
 #include "DelegateBase.h"
 
 namespace SA {
@@ -30,6 +31,9 @@ namespace SA {
 		delegate() = default;
 
 		bool isNull() const { return invocation.stub == nullptr; }
+		//identity of the bound target, used by the delegate profiler
+		void* getObject() const { return invocation.object; }
+		uintptr_t getStubId() const { return reinterpret_cast<uintptr_t>(invocation.stub); }
 		bool operator ==(void* ptr) const {
 			return (ptr == nullptr) && this->isNull();
 		} //operator ==
@@ -0,0 +1,107 @@
+//
+//  DelegateProfiler.cpp
+//  ofxMediaSystem
+//
+
+#include "DelegateProfiler.h"
+#include <algorithm>
+#include "mediasystem/util/Log.h"
+
+namespace mediasystem {
+    
+    DelegateProfiler::DelegateProfiler(size_t windowFrames):
+    mWindow(std::max<size_t>(windowFrames, 1))
+    {}
+    
+    void DelegateProfiler::record(type_id_t type, const void* target, uintptr_t stub, std::chrono::nanoseconds duration)
+    {
+        auto& entry = mEntries[Key(type, target, stub)];
+        if(entry.slots.empty()){
+            entry.slots.resize(mWindow);
+        }
+        auto& slot = entry.slots[mSlot];
+        auto nanos = static_cast<int64_t>(duration.count());
+        ++slot.calls;
+        slot.nanos += nanos;
+        slot.maxNanos = std::max(slot.maxNanos, nanos);
+        ++entry.lifetimeCalls;
+    }
+    
+    void DelegateProfiler::setEventName(type_id_t type, std::string name)
+    {
+        mEventNames[type] = std::move(name);
+    }
+    
+    void DelegateProfiler::endFrame()
+    {
+        ++mFrame;
+        if(mDumpInterval && mFrame % mDumpInterval == 0){
+            dump(mDumpCount);
+        }
+        mSlot = (mSlot + 1) % mWindow;
+        for(auto & entry : mEntries){
+            entry.second.slots[mSlot] = Slot();
+        }
+    }
+    
+    void DelegateProfiler::setWindow(size_t frames)
+    {
+        mWindow = std::max<size_t>(frames, 1);
+        mSlot = 0;
+        for(auto & entry : mEntries){
+            entry.second.slots.assign(mWindow, Slot());
+        }
+    }
+    
+    std::vector<DelegateStats> DelegateProfiler::getStats(size_t maxCount) const
+    {
+        std::vector<DelegateStats> stats;
+        stats.reserve(mEntries.size());
+        for(auto & entry : mEntries){
+            DelegateStats stat;
+            stat.eventType = std::get<0>(entry.first);
+            stat.target = std::get<1>(entry.first);
+            stat.stub = std::get<2>(entry.first);
+            stat.lifetimeCalls = entry.second.lifetimeCalls;
+            auto name = mEventNames.find(stat.eventType);
+            if(name != mEventNames.end()){
+                stat.eventName = name->second;
+            }
+            int64_t nanos = 0;
+            int64_t maxNanos = 0;
+            for(auto & slot : entry.second.slots){
+                stat.calls += slot.calls;
+                nanos += slot.nanos;
+                maxNanos = std::max(maxNanos, slot.maxNanos);
+            }
+            stat.totalMs = nanos / 1000000.;
+            stat.maxMs = maxNanos / 1000000.;
+            stat.meanMs = stat.calls ? stat.totalMs / stat.calls : 0.;
+            stats.emplace_back(std::move(stat));
+        }
+        std::sort(stats.begin(), stats.end(), [](const DelegateStats& a, const DelegateStats& b){
+            return a.totalMs > b.totalMs;
+        });
+        if(maxCount && stats.size() > maxCount){
+            stats.resize(maxCount);
+        }
+        return stats;
+    }
+    
+    void DelegateProfiler::dump(size_t maxCount) const
+    {
+        auto stats = getStats(maxCount);
+        MS_LOG_INFO("delegate profiler: top " << stats.size() << " delegates over the last " << mWindow << " frames");
+        for(auto & stat : stats){
+            MS_LOG_INFO("  " << (stat.eventName.empty() ? "<unnamed event>" : stat.eventName) << " target: " << stat.target << " calls: " << stat.calls << " total ms: " << stat.totalMs << " mean ms: " << stat.meanMs << " max ms: " << stat.maxMs);
+        }
+    }
+    
+    void DelegateProfiler::reset()
+    {
+        mEntries.clear();
+        mSlot = 0;
+        mFrame = 0;
+    }
+    
+}//end namespace mediasystem
@@ -0,0 +1,103 @@
+//
+//  DelegateProfiler.h
+//  ofxMediaSystem
+//
+//  Per (event type, delegate) invocation timing over a rolling window of frames.
+//  Only built into EventManager when MS_ALLOW_DELEGATE_PROFILE is defined, otherwise the
+//  macros below expand to nothing and multicast calls delegates directly.
+//
+
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "mediasystem/util/TypeID.hpp"
+
+#if defined(MS_ALLOW_DELEGATE_PROFILE)
+#define MS_DELEGATE_PROFILE_START(clockname)\
+auto clockname##_delegate_start = std::chrono::steady_clock::now();
+
+#define MS_DELEGATE_PROFILE_STOP(clockname, profiler, type, delegate)\
+profiler.record(type, delegate.getObject(), delegate.getStubId(), std::chrono::steady_clock::now() - clockname##_delegate_start);
+
+#define MS_DELEGATE_PROFILE_NAME(profiler, type, name)\
+profiler.setEventName(type, name);
+
+#define MS_DELEGATE_PROFILE_FRAME(profiler)\
+profiler.endFrame();
+#else
+#define MS_DELEGATE_PROFILE_START(clockname) ((void)0)
+#define MS_DELEGATE_PROFILE_STOP(clockname, profiler, type, delegate) ((void)0)
+#define MS_DELEGATE_PROFILE_NAME(profiler, type, name) ((void)0)
+#define MS_DELEGATE_PROFILE_FRAME(profiler) ((void)0)
+#endif
+
+namespace mediasystem {
+    
+    struct DelegateStats {
+        type_id_t eventType{nullptr};
+        std::string eventName;
+        const void* target{nullptr};
+        uintptr_t stub{0};
+        size_t calls{0};            //within the window
+        double totalMs{0.};         //within the window
+        double meanMs{0.};          //within the window
+        double maxMs{0.};           //within the window
+        size_t lifetimeCalls{0};
+    };
+    
+    class DelegateProfiler {
+    public:
+        
+        static const size_t DEFAULT_WINDOW = 120;
+        
+        explicit DelegateProfiler(size_t windowFrames = DEFAULT_WINDOW);
+        
+        void record(type_id_t type, const void* target, uintptr_t stub, std::chrono::nanoseconds duration);
+        void setEventName(type_id_t type, std::string name);
+        
+        //closes the current frame slot, dumps to the log every dump interval frames
+        void endFrame();
+        
+        //changing the window size discards the collected window
+        void setWindow(size_t frames);
+        inline size_t getWindow() const { return mWindow; }
+        
+        //0 disables the periodic dump
+        inline void setDumpInterval(size_t frames){ mDumpInterval = frames; }
+        inline size_t getDumpInterval() const { return mDumpInterval; }
+        inline void setDumpCount(size_t count){ mDumpCount = count; }
+        
+        //sorted by total time within the window, most expensive first, 0 returns everything
+        std::vector<DelegateStats> getStats(size_t maxCount = 0) const;
+        void dump(size_t maxCount) const;
+        void reset();
+        
+    private:
+        
+        using Key = std::tuple<type_id_t, const void*, uintptr_t>;
+        
+        struct Slot {
+            size_t calls{0};
+            int64_t nanos{0};
+            int64_t maxNanos{0};
+        };
+        
+        struct Entry {
+            std::vector<Slot> slots;
+            size_t lifetimeCalls{0};
+        };
+        
+        std::map<Key, Entry> mEntries;
+        std::map<type_id_t, std::string> mEventNames;
+        size_t mWindow;
+        size_t mSlot{0};
+        size_t mFrame{0};
+        size_t mDumpInterval{0};
+        size_t mDumpCount{10};
+    };
+    
+}//end namespace mediasystem
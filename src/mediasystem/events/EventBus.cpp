@@ -0,0 +1,148 @@
+//
+//  EventBus.cpp
+//  ofxMediaSystem
+//
+
+#include "EventBus.h"
+#include "mediasystem/util/Log.h"
+
+namespace mediasystem {
+    
+    EventBus::EventBus():
+    mThreadedQueue([&](IEventRef& event){
+        publish(event);
+        return true;
+    })
+    {}
+    
+    void EventBus::subscribe(EventManager* receiver, type_id_t type, EventTopicMask topics)
+    {
+        if(!receiver){
+            MS_LOG_ERROR("Attempting to subscribe a null receiver to the event bus");
+            return;
+        }
+        auto& typeRoutes = mRoutes[type];
+        auto found = std::find_if(typeRoutes.routes.begin(), typeRoutes.routes.end(), [receiver](const Route& route){
+            return route.receiver == receiver;
+        });
+        if(found != typeRoutes.routes.end()){
+            found->topics = topics;
+        }else{
+            typeRoutes.routes.push_back(Route{receiver, topics, true});
+        }
+        updateTopics(typeRoutes);
+    }
+    
+    void EventBus::unsubscribe(EventManager* receiver, type_id_t type)
+    {
+        auto found = mRoutes.find(type);
+        if(found == mRoutes.end()){
+            return;
+        }
+        auto& routes = found->second.routes;
+        routes.erase(std::remove_if(routes.begin(), routes.end(), [receiver](const Route& route){
+            return route.receiver == receiver;
+        }), routes.end());
+        if(routes.empty()){
+            mRoutes.erase(found);
+        }else{
+            updateTopics(found->second);
+        }
+    }
+    
+    void EventBus::unsubscribeAll(EventManager* receiver)
+    {
+        auto it = mRoutes.begin();
+        while(it != mRoutes.end()){
+            auto& routes = it->second.routes;
+            routes.erase(std::remove_if(routes.begin(), routes.end(), [receiver](const Route& route){
+                return route.receiver == receiver;
+            }), routes.end());
+            if(routes.empty()){
+                it = mRoutes.erase(it);
+            }else{
+                updateTopics(it->second);
+                ++it;
+            }
+        }
+    }
+    
+    void EventBus::setReceiverEnabled(EventManager* receiver, bool enabled)
+    {
+        for(auto & typeRoutes : mRoutes){
+            bool changed = false;
+            for(auto & route : typeRoutes.second.routes){
+                if(route.receiver == receiver && route.enabled != enabled){
+                    route.enabled = enabled;
+                    changed = true;
+                }
+            }
+            if(changed){
+                updateTopics(typeRoutes.second);
+            }
+        }
+    }
+    
+    size_t EventBus::publish(const IEventRef& event)
+    {
+        auto found = mRoutes.find(event->getType());
+        if(found == mRoutes.end()){
+            return 0;
+        }
+        auto topics = event->getTopics();
+        auto& typeRoutes = found->second;
+        if((typeRoutes.topics & topics) == 0){
+            return 0;
+        }
+        size_t count = 0;
+        for(auto & route : typeRoutes.routes){
+            if(route.enabled && (route.topics & topics) != 0){
+                route.receiver->queueEvent(event);
+                ++count;
+            }
+        }
+        return count;
+    }
+    
+    void EventBus::publishThreaded(const IEventRef& event)
+    {
+        if(!mThreadedQueue.push(event)){
+            MS_LOG_ERROR("Event bus threaded queue was aborted while full, event dropped!");
+        }
+    }
+    
+    void EventBus::publishThreaded(IEventRef&& event)
+    {
+        if(!mThreadedQueue.push(std::move(event))){
+            MS_LOG_ERROR("Event bus threaded queue was aborted while full, event dropped!");
+        }
+    }
+    
+    void EventBus::processEvents()
+    {
+        mThreadedQueue.dequeue();
+    }
+    
+    size_t EventBus::getNumSubscribers(type_id_t type) const
+    {
+        auto found = mRoutes.find(type);
+        return found != mRoutes.end() ? found->second.routes.size() : 0;
+    }
+    
+    void EventBus::clear()
+    {
+        mRoutes.clear();
+        mThreadedQueue.reset();
+    }
+    
+    void EventBus::updateTopics(TypeRoutes& typeRoutes)
+    {
+        typeRoutes.topics = 0;
+        for(auto & route : typeRoutes.routes){
+            if(route.enabled){
+                typeRoutes.topics |= route.topics;
+            }
+        }
+    }
+    
+}//end namespace mediasystem
@@ -0,0 +1,88 @@
+//
+//  EventBus.h
+//  ofxMediaSystem
+//
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include "mediasystem/events/EventManager.h"
+
+namespace mediasystem {
+    
+    //Routes one shared event into every EventManager subscribed to its type whose topic mask intersects
+    //the event's topics. Nothing is copied, each receiver queues the same IEventRef into its own lanes.
+    class EventBus {
+    public:
+        
+        EventBus();
+        ~EventBus() = default;
+        
+        //not copyable, the threaded queue handler captures this
+        EventBus(const EventBus&) = delete;
+        EventBus& operator=(const EventBus&) = delete;
+        
+        template<typename EventType>
+        void subscribe(EventManager* receiver, EventTopicMask topics = ALL_EVENT_TOPICS){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            subscribe(receiver, type_id<EventType>, topics);
+        }
+        void subscribe(EventManager* receiver, type_id_t type, EventTopicMask topics = ALL_EVENT_TOPICS);
+        
+        template<typename EventType>
+        void unsubscribe(EventManager* receiver){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            unsubscribe(receiver, type_id<EventType>);
+        }
+        void unsubscribe(EventManager* receiver, type_id_t type);
+        void unsubscribeAll(EventManager* receiver);
+        
+        //disabled receivers keep their subscriptions but are skipped when routing
+        void setReceiverEnabled(EventManager* receiver, bool enabled);
+        
+        //main thread only, queues into each matching receiver and returns the number of receivers reached
+        size_t publish(const IEventRef& event);
+        
+        template<typename EventType, typename...Args>
+        size_t publishEvent(Args&&...args){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            return publish(std::make_shared<EventType>(std::forward<Args>(args)...));
+        }
+        
+        //safe from any thread, routed on the next processEvents()
+        void publishThreaded(const IEventRef& event);
+        void publishThreaded(IEventRef&& event);
+        
+        //routes events published from other threads, call on the main thread before receivers process
+        void processEvents();
+        
+        template<typename EventType>
+        size_t getNumSubscribers() const {
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            return getNumSubscribers(type_id<EventType>);
+        }
+        size_t getNumSubscribers(type_id_t type) const;
+        
+        void clear();
+        
+    private:
+        
+        struct Route {
+            EventManager* receiver;
+            EventTopicMask topics;
+            bool enabled;
+        };
+        
+        struct TypeRoutes {
+            EventTopicMask topics{0}; //union of the enabled routes, rejects unroutable events without a scan
+            std::vector<Route> routes;
+        };
+        
+        static void updateTopics(TypeRoutes& routes);
+        
+        std::map<type_id_t, TypeRoutes> mRoutes;
+        TimedMPSCQueue<IEventRef,1024> mThreadedQueue;
+    };
+    
+}//end namespace mediasystem
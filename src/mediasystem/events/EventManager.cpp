@@ -11,90 +11,108 @@
 namespace mediasystem {
     
     EventManager::EventManager(int maxDequeueTime):
-    mQueue([&](IEventRef& event){
-        auto& delegateList = mEvents[event->getType()];
-        if(!delegateList.empty()){
-            auto ret = multicast(delegateList, event);
-            switch (ret){
-                case EventStatus::DEFER_EVENT:
-                {
-                    deferEvent(event);
-                }break;
-                case EventStatus::ABORT_ALL_QUEUED_EVENTS_OF_THIS_TYPE:
-                {
-                    //todo abort this type!
-                }break;
-                default: break;
-            }
-        }
-        return true;
-    }, maxDequeueTime),
-    mThreadedQueue([&](IEventRef& event){
-        auto& delegateList = mEvents[event->getType()];
-        if(!delegateList.empty()){
-            auto ret = multicast(delegateList, event);
-            switch (ret){
-                case EventStatus::DEFER_EVENT:
-                {
-                    deferEvent(event);
-                }break;
-                case EventStatus::ABORT_ALL_QUEUED_EVENTS_OF_THIS_TYPE:
-                {
-                    //todo abort this type!
-                }break;
-                default: break;
-            }
-        }
+    mMaxDequeueTime(maxDequeueTime),
+    mLanes{{
+        EventLane([&](QueuedEvent& queued){ return dispatchQueued(queued); }),
+        EventLane([&](QueuedEvent& queued){ return dispatchQueued(queued); }),
+        EventLane([&](QueuedEvent& queued){ return dispatchQueued(queued); })
+    }},
+    //moving threaded events into their lanes is cheap, the dequeue budget is spent on the lanes
+    mThreadedQueue([&](QueuedEvent& queued){
+        routeThreaded(queued);
         return true;
-    }, maxDequeueTime)
-    {}
+    })
+    {
+        static_assert(NUM_LANES == 3, "EventManager lane initializers must match EventPriority");
+    }
+    
+    EventManager::~EventManager()
+    {
+        cancelAsyncDelegates();
+    }
     
     void EventManager::queueEvent(const IEventRef& event)
     {
-        mQueue.push(event);
+        queueEvent(event, getEventPriority(event->getType()));
     }
     
     void EventManager::queueEvent(IEventRef&& event)
     {
-        mQueue.push(std::move(event));
+        auto priority = getEventPriority(event->getType());
+        queueEvent(std::move(event), priority);
+    }
+    
+    void EventManager::queueEvent(const IEventRef& event, EventPriority priority)
+    {
+        QueuedEvent queued(event, priority);
+        queued.derived = mDispatchDepth > 0;
+        mLanes[static_cast<size_t>(priority)].push(std::move(queued));
+    }
+    
+    void EventManager::queueEvent(IEventRef&& event, EventPriority priority)
+    {
+        QueuedEvent queued(std::move(event), priority);
+        queued.derived = mDispatchDepth > 0;
+        mLanes[static_cast<size_t>(priority)].push(std::move(queued));
     }
     
+    EventPriority EventManager::getEventPriority(type_id_t type) const
+    {
+        auto found = mEventPriorities.find(type);
+        if(found != mEventPriorities.end()){
+            return found->second;
+        }
+        return EventPriority::NORMAL;
+    }
+    
+    //the lane is resolved on the main thread when the event is routed, producers never touch mEventPriorities
     void EventManager::queueThreadedEvent(const IEventRef& event)
     {
-        if(!mThreadedQueue.tryPush(event)){
-            MS_LOG_ERROR("Threaded queue is full or locked!");
+        if(!mThreadedQueue.push(QueuedEvent(event, EventPriority::NORMAL))){
+            MS_LOG_ERROR("Threaded queue was aborted while full, event dropped!");
         }
     }
     
     void EventManager::queueThreadedEvent(IEventRef&& event)
     {
-        if(!mThreadedQueue.tryPush(std::move(event))){
-            MS_LOG_ERROR("Threaded queue is full or locked!");
+        if(!mThreadedQueue.push(QueuedEvent(std::move(event), EventPriority::NORMAL))){
+            MS_LOG_ERROR("Threaded queue was aborted while full, event dropped!");
         }
     }
     
-    void EventManager::deferEvent(const IEventRef& event)
+    void EventManager::deferEvent(const IEventRef& event, EventPriority priority)
     {
-        auto found = std::find_if( mDeferedEvents.begin(), mDeferedEvents.end(), [&event](const IEventRef& e){
-            return event->getType() == e->getType();
+        auto found = std::find_if( mDeferedEvents.begin(), mDeferedEvents.end(), [&event](const QueuedEvent& e){
+            return event->getType() == e.event->getType();
         });
         if(found == mDeferedEvents.end()){
-            mDeferedEvents.push_back(event);
+            mDeferedEvents.emplace_back(event, priority);
+            mDeferedEvents.back().deferred = true;
         }else{
             //todo this doesn't preserve any ordering...if that matters...
-            *found = event;
+            *found = QueuedEvent(event, priority);
+            found->deferred = true;
         }
     }
     
     void EventManager::triggerEvent(const IEventRef& event)
+    {
+        if(mRecordHook && mDispatchDepth == 0)
+            mRecordHook(event);
+        dispatch(event, getEventPriority(event->getType()));
+    }
+    
+    void EventManager::dispatch(const IEventRef& event, EventPriority priority)
     {
         auto& delegateList = mEvents[event->getType()];
         if(!delegateList.empty()){
+            ++mDispatchDepth;
             auto ret = multicast(delegateList, event);
+            --mDispatchDepth;
             switch (ret){
                 case EventStatus::DEFER_EVENT:
                 {
-                    deferEvent(event);
+                    deferEvent(event, priority);
                 }break;
                 case EventStatus::ABORT_ALL_QUEUED_EVENTS_OF_THIS_TYPE:
                 {
@@ -105,12 +123,59 @@ namespace mediasystem {
         }
     }
     
+    bool EventManager::dispatchQueued(QueuedEvent& queued)
+    {
+        //lane latency is measured against the start of the lane pass so the clock isn't read per event
+        auto& counters = mLaneCounters[static_cast<size_t>(queued.priority)];
+        auto latency = std::chrono::duration<double, std::milli>(mLanePassTime - queued.queuedAt).count();
+        counters.averageLatencyMs = counters.dispatched == 0 ? latency : 0.9 * counters.averageLatencyMs + 0.1 * latency;
+        counters.maxLatencyMs = std::max(counters.maxLatencyMs, latency);
+        ++counters.dispatched;
+        
+        if(mRecordHook && !queued.deferred && !queued.derived)
+            mRecordHook(queued.event);
+        
+        if(mLatencyHistogramsEnabled){
+            dispatchTimed(queued, queued.priority);
+        }else{
+            dispatch(queued.event, queued.priority);
+        }
+        
+        //returning false stops the lane once a starvation quota has been served
+        return ++mLaneDispatchCount < mLaneDispatchLimit;
+    }
+    
+    //threaded events keep the time they were queued on the producer thread, lane latency includes the handoff
+    void EventManager::routeThreaded(QueuedEvent& queued)
+    {
+        queued.priority = getEventPriority(queued.event->getType());
+        mLanes[static_cast<size_t>(queued.priority)].push(std::move(queued));
+    }
+    
+    void EventManager::dispatchTimed(const QueuedEvent& queued, EventPriority priority)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        auto type = queued.event->getType();
+        dispatch(queued.event, priority);
+        auto end = std::chrono::steady_clock::now();
+        auto& histograms = mLatencyHistograms[type];
+        histograms.queueWait.add(begin - queued.queuedAt);
+        histograms.handler.add(end - begin);
+    }
+    
     EventStatus EventManager::multicast(EventDelegateList& list, const IEventRef& event)
     {
+        auto topics = event->getTopics();
         auto it = list.begin();
         auto end = list.end();
         while(it != end){
-            auto ret = (*it)(event);
+            if((it->topics & topics) == 0){
+                ++it;
+                continue;
+            }
+            MS_DELEGATE_PROFILE_START(multicast);
+            auto ret = it->delegate(event);
+            MS_DELEGATE_PROFILE_STOP(multicast, mDelegateProfiler, event->getType(), it->delegate);
             switch(ret){
                 case EventStatus::FAILED:{
                     MS_LOG_ERROR("Event delegate failed during processing of event: " /* todo overload stream operator */);
@@ -136,22 +201,146 @@ namespace mediasystem {
         return EventStatus::SUCCESS;
     }
 
+    EventStatus EventManager::runAsync(const AsyncEventHandler& handler, const IEventRef& event)
+    {
+        auto state = mAsyncState;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            ++state->inFlight;
+        }
+        auto& jobs = mAsyncJobs ? *mAsyncJobs : DefaultJobSystem::get();
+        jobs.schedule([this, state, handler, event]{
+            if(!state->cancelled->load(std::memory_order_acquire)){
+                try{
+                    auto result = handler(event, AsyncCancelToken(state->cancelled));
+                    //the owner can't be destroyed until inFlight drops, so delivering here is safe
+                    if(result && !state->cancelled->load(std::memory_order_acquire)){
+                        //a reply to a dispatched event, replaying the original raises it again
+                        QueuedEvent queued(std::move(result), EventPriority::NORMAL);
+                        queued.derived = true;
+                        if(!mThreadedQueue.push(std::move(queued))){
+                            MS_LOG_ERROR("Threaded queue was aborted while full, event dropped!");
+                        }
+                    }
+                }catch(const std::exception& e){
+                    MS_LOG_ERROR(std::string("Async event delegate threw: ") + e.what());
+                }catch(...){
+                    MS_LOG_ERROR("Async event delegate threw an unknown exception");
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                --state->inFlight;
+            }
+            state->finished.notify_all();
+        });
+        return EventStatus::SUCCESS;
+    }
+    
+    void EventManager::cancelAsyncDelegates()
+    {
+        auto state = mAsyncState;
+        state->cancelled->store(true, std::memory_order_release);
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->finished.wait(lock, [&state]{ return state->inFlight == 0; });
+        }
+        //fresh state so the delegates keep working if the manager is reused
+        mAsyncState = std::make_shared<AsyncState>();
+    }
+    
+    size_t EventManager::getNumPendingAsyncTasks() const
+    {
+        std::lock_guard<std::mutex> lock(mAsyncState->mutex);
+        return mAsyncState->inFlight;
+    }
+    
+    void EventManager::processLanes()
+    {
+        auto start = std::chrono::steady_clock::now();
+        mLanePassTime = start;
+        
+        for(size_t i = 0; i < NUM_LANES; i++){
+            auto& lane = mLanes[i];
+            auto& counters = mLaneCounters[i];
+            
+            if(lane.empty()){
+                counters.starvedPasses = 0;
+                continue;
+            }
+            
+            auto dispatchedBefore = counters.dispatched;
+            
+            mLanePassTime = std::chrono::steady_clock::now();
+            
+            auto remaining = std::chrono::microseconds(EventLane::NO_TIME_LIMIT);
+            if(mMaxDequeueTime >= 0){
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(mLanePassTime - start);
+                remaining = std::max(std::chrono::microseconds(0), detail::dequeueBudgetFromMs(mMaxDequeueTime) - elapsed);
+            }
+            
+            if(remaining.count() != 0){
+                mLaneDispatchCount = 0;
+                mLaneDispatchLimit = UNLIMITED_DISPATCH;
+                lane.setMaxDequeueTime(remaining);
+                lane.dequeue();
+            }
+            
+            if(counters.dispatched != dispatchedBefore || lane.empty()){
+                counters.starvedPasses = 0;
+            }else if(++counters.starvedPasses >= mLaneStarvationLimit){
+                //higher lanes have been eating the whole budget, serve a quota regardless
+                ++counters.totalStarvedPasses;
+                counters.starvedPasses = 0;
+                mLaneDispatchCount = 0;
+                mLaneDispatchLimit = mLaneStarvationQuota;
+                lane.setMaxDequeueTime(EventLane::NO_TIME_LIMIT);
+                lane.dequeue();
+            }
+        }
+        
+        mLaneDispatchLimit = UNLIMITED_DISPATCH;
+    }
+
     void EventManager::processEvents()
     {
+        MS_DELEGATE_PROFILE_FRAME(mDelegateProfiler);
         mThreadedQueue.dequeue();
-        mQueue.dequeue();
+        processLanes();
         if(!mDeferedEvents.empty()){
             for(auto & defered : mDeferedEvents){
-                mQueue.push(defered);
+                mLanes[static_cast<size_t>(defered.priority)].push(std::move(defered));
             }
             mDeferedEvents.clear();
         }
     }
     
+    EventLaneStats EventManager::getLaneStats(EventPriority priority) const
+    {
+        auto lane = static_cast<size_t>(priority);
+        auto& counters = mLaneCounters[lane];
+        EventLaneStats stats;
+        stats.depth = mLanes[lane].size();
+        stats.dispatched = counters.dispatched;
+        stats.starvedPasses = counters.totalStarvedPasses;
+        stats.averageLatencyMs = counters.averageLatencyMs;
+        stats.maxLatencyMs = counters.maxLatencyMs;
+        return stats;
+    }
+    
+    void EventManager::resetLaneStats()
+    {
+        for(auto & counters : mLaneCounters){
+            counters = LaneCounters();
+        }
+    }
+    
     void EventManager::clearQueues()
     {
         mThreadedQueue.reset();
-        mQueue.clear();
+        for(auto & lane : mLanes){
+            lane.clear();
+        }
         mDeferedEvents.clear();
     }
     
@@ -161,6 +350,7 @@ namespace mediasystem {
             delegateList.second.clear();
         }
         mEvents.clear();
+        mAsyncDelegates.clear();
     }
     
 }//end namespace mediasystem
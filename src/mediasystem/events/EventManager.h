@@ -8,11 +8,21 @@
 #pragma once
 
 #include <map>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include "ofMain.h"
 #include "IEvent.h"
 #include "mediasystem/util/Log.h"
 #include "mediasystem/util/TimedQueue.hpp"
-#include "mediasystem/util/TimedLockingQueue.hpp"
+#include "mediasystem/util/TimedMPSCQueue.hpp"
+#include "mediasystem/util/LatencyHistogram.hpp"
+#include "mediasystem/util/JobSystem.h"
+#include "DelegateProfiler.h"
 #include "MultiCastDelegate.h"
 #include "Delegate.h"
 #include "mediasystem/util/TypeID.hpp"
@@ -29,16 +39,89 @@ namespace mediasystem {
     };
     
     using EventDelegate = SA::delegate<EventStatus(const IEventRef&)>;
-    using EventDelegateList = std::list<EventDelegate>;
-        
+    
+    struct EventDelegateEntry {
+        EventDelegateEntry(EventDelegate d, EventTopicMask t):
+            delegate(std::move(d)),
+            topics(t)
+        {}
+        EventDelegate delegate;
+        EventTopicMask topics;
+    };
+    
+    //holds EventDelegateEntry rather than bare EventDelegates, code walking a list reaches the delegate through .delegate
+    using EventDelegateList = std::list<EventDelegateEntry>;
+    
+    //queued events are dispatched from the highest priority lane down, the dequeue budget is spent in that order
+    enum class EventPriority {
+        CRITICAL,
+        NORMAL,
+        BACKGROUND,
+        NUM_PRIORITIES
+    };
+    
+    struct QueuedEvent {
+        QueuedEvent() = default;
+        QueuedEvent(IEventRef e, EventPriority p):
+            event(std::move(e)),
+            priority(p),
+            queuedAt(std::chrono::steady_clock::now())
+        {}
+        IEventRef event;
+        EventPriority priority{EventPriority::NORMAL};
+        std::chrono::steady_clock::time_point queuedAt;
+        bool deferred{false};
+        //queued by a delegate while another event was being dispatched
+        bool derived{false};
+    };
+    
+    using ThreadedEventQueue = TimedMPSCQueue<QueuedEvent,1024>;
+    using ThreadedEventOverflowPolicy = ThreadedEventQueue::OverflowPolicy;
+    
+    struct EventLaneStats {
+        size_t depth{0};
+        size_t dispatched{0};
+        size_t starvedPasses{0};
+        double averageLatencyMs{0.};
+        double maxLatencyMs{0.};
+    };
+
+    //time spent waiting in a queue and time spent in the delegates, per event type
+    struct EventLatencyHistograms {
+        LatencyHistogram queueWait;
+        LatencyHistogram handler;
+    };
+
+    //handed to async delegates so long running handlers can bail out once their EventManager cancels
+    class AsyncCancelToken {
+    public:
+        explicit AsyncCancelToken(std::shared_ptr<const std::atomic_bool> cancelled):mCancelled(std::move(cancelled)){}
+        inline bool isCancelled() const { return mCancelled->load(std::memory_order_acquire); }
+    private:
+        std::shared_ptr<const std::atomic_bool> mCancelled;
+    };
+    
+    //runs on a worker thread, a returned event is queued back on the owning EventManager
+    using AsyncEventHandler = std::function<IEventRef(const IEventRef&, const AsyncCancelToken&)>;
+    
+    //Sees events as they enter the manager from outside: queued or triggered while no delegate is running,
+    //or queued from another thread. Events delegates raise in response are left out, replaying the
+    //originals raises them again. Deferred re-dispatches are not reported twice.
+    using EventRecordHook = std::function<void(const IEventRef&)>;
+    
     class EventManager {
     public:
         
         EventManager(int mexDequeueTime = TimedQueue<IEventRef>::NO_TIME_LIMIT);
-        virtual ~EventManager() = default;
+        virtual ~EventManager();
         
         void processEvents();
+        
+        //budget for one processEvents() pass over every lane, threaded events included
+        inline void setMaxDequeueTime( int maxMs ){ mMaxDequeueTime = maxMs; }
+        inline int getMaxDequeueTime() const { return mMaxDequeueTime; }
     
+        //queues into the lane registered for EventType, NORMAL by default
         template<typename EventType, typename...Args>
         void queueEvent(Args&&...args){
             static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
@@ -47,6 +130,52 @@ namespace mediasystem {
         void queueEvent(const IEventRef& event);
         void queueEvent(IEventRef&& event);
         
+        template<typename EventType, typename...Args>
+        void queuePriorityEvent(EventPriority priority, Args&&...args){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            queueEvent(std::make_shared<EventType>(std::forward<Args>(args)...), priority);
+        }
+        void queueEvent(const IEventRef& event, EventPriority priority);
+        void queueEvent(IEventRef&& event, EventPriority priority);
+        
+        //sets the default lane for queued events of EventType
+        template<typename EventType>
+        void setEventPriority(EventPriority priority){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            mEventPriorities[type_id<EventType>] = priority;
+        }
+        
+        template<typename EventType>
+        EventPriority getEventPriority() const {
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            return getEventPriority(type_id<EventType>);
+        }
+        EventPriority getEventPriority(type_id_t type) const;
+        
+        //a lane that has pending events but got none of the budget for this many passes
+        //is guaranteed its starvation quota on the next pass regardless of budget
+        inline void setLaneStarvationLimit(size_t passes){ mLaneStarvationLimit = passes; }
+        inline size_t getLaneStarvationLimit() const { return mLaneStarvationLimit; }
+        inline void setLaneStarvationQuota(size_t numEvents){ mLaneStarvationQuota = numEvents; }
+        inline size_t getLaneStarvationQuota() const { return mLaneStarvationQuota; }
+        
+        EventLaneStats getLaneStats(EventPriority priority) const;
+        void resetLaneStats();
+        
+        //optional per event type histograms of queue wait and handler time, costs two clock reads per queued event
+        inline void setLatencyHistogramsEnabled(bool enabled){ mLatencyHistogramsEnabled = enabled; }
+        inline bool getLatencyHistogramsEnabled() const { return mLatencyHistogramsEnabled; }
+        inline const std::map<type_id_t, EventLatencyHistograms>& getLatencyHistograms() const { return mLatencyHistograms; }
+        inline void resetLatencyHistograms(){ mLatencyHistograms.clear(); }
+        
+        template<typename EventType>
+        const EventLatencyHistograms* getLatencyHistograms() const {
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            auto found = mLatencyHistograms.find(type_id<EventType>);
+            return found != mLatencyHistograms.end() ? &found->second : nullptr;
+        }
+        
+        //safe from any thread, moved into the lane registered for EventType at the start of processEvents()
         template<typename EventType, typename...Args>
         void queueThreadedEvent(Args&&...args){
             static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
@@ -55,6 +184,13 @@ namespace mediasystem {
         void queueThreadedEvent(const IEventRef& event);
         void queueThreadedEvent(IEventRef&& event);
         
+        //what worker threads do when the threaded queue is full, defaults to GROW so no events are lost
+        void setThreadedEventOverflowPolicy(ThreadedEventOverflowPolicy policy){ mThreadedQueue.setOverflowPolicy(policy); }
+        ThreadedEventOverflowPolicy getThreadedEventOverflowPolicy() const { return mThreadedQueue.getOverflowPolicy(); }
+        size_t getNumDroppedThreadedEvents() const { return mThreadedQueue.getDroppedCount(); }
+        size_t getNumOverflowedThreadedEvents() const { return mThreadedQueue.getOverflowCount(); }
+        size_t getNumBlockedThreadedEvents() const { return mThreadedQueue.getBlockedCount(); }
+        
         template<typename EventType, typename...Args>
         void triggerEvent(Args&&...args){
             static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
@@ -62,18 +198,22 @@ namespace mediasystem {
         }
         void triggerEvent(const IEventRef& event);
         
+        //the delegate is skipped for events whose topics don't intersect its topic mask
         template<typename EventType>
-        void addDelegate(EventDelegate delegate){
+        void addDelegate(EventDelegate delegate, EventTopicMask topics = ALL_EVENT_TOPICS){
             static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
             auto& list = mEvents[type_id<EventType>];
-            list.emplace_back(std::move(delegate));
+            list.emplace_back(std::move(delegate), topics);
+            MS_DELEGATE_PROFILE_NAME(mDelegateProfiler, type_id<EventType>, typeid(EventType).name());
         }
         
         template<typename EventType>
         void removeDelegate(EventDelegate delegate){
             static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
             auto& list = mEvents[type_id<EventType>];
-            auto found = std::find(list.begin(), list.end(), delegate);
+            auto found = std::find_if(list.begin(), list.end(), [&delegate](const EventDelegateEntry& entry){
+                return entry.delegate == delegate;
+            });
             if(found != list.end()){
                 list.erase(found);
             }else{
@@ -81,6 +221,31 @@ namespace mediasystem {
             }
         }
         
+        //the handler runs on the async pool instead of the dispatching thread, returns the delegate for removeAsyncDelegate
+        template<typename EventType>
+        EventDelegate addAsyncDelegate(AsyncEventHandler handler, EventTopicMask topics = ALL_EVENT_TOPICS){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            mAsyncDelegates.emplace_back(*this, std::move(handler));
+            auto delegate = EventDelegate::create<AsyncDelegate, &AsyncDelegate::invoke>(&mAsyncDelegates.back());
+            addDelegate<EventType>(delegate, topics);
+            return delegate;
+        }
+        
+        template<typename EventType>
+        void removeAsyncDelegate(EventDelegate delegate){
+            removeDelegate<EventType>(delegate);
+            mAsyncDelegates.remove_if([&delegate](AsyncDelegate& async){
+                return EventDelegate::create<AsyncDelegate, &AsyncDelegate::invoke>(&async) == delegate;
+            });
+        }
+        
+        //handlers run as jobs, defaults to the DefaultJobSystem. Scene::setJobSystem() sets this too.
+        inline void setAsyncJobSystem(JobSystem* jobs){ mAsyncJobs = jobs; }
+        
+        //stops queued handlers from starting and results from being delivered, blocks until running handlers return
+        void cancelAsyncDelegates();
+        size_t getNumPendingAsyncTasks() const;
+        
         template<typename EventType>
         size_t getNumDelegates(){
             static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
@@ -90,17 +255,80 @@ namespace mediasystem {
         
         void clearQueues();
         void clearDelegates();
+        
+        inline void setRecordHook(EventRecordHook hook){ mRecordHook = std::move(hook); }
+        inline void clearRecordHook(){ mRecordHook = nullptr; }
+        inline bool hasRecordHook() const { return mRecordHook != nullptr; }
+        
+#if defined(MS_ALLOW_DELEGATE_PROFILE)
+        //a frame is one processEvents() call
+        DelegateProfiler& getDelegateProfiler(){ return mDelegateProfiler; }
+        const DelegateProfiler& getDelegateProfiler() const { return mDelegateProfiler; }
+#endif
 
     private:
         
-        static EventStatus multicast(EventDelegateList& list, const IEventRef& event);
+        static const size_t NUM_LANES = static_cast<size_t>(EventPriority::NUM_PRIORITIES);
+        static const size_t UNLIMITED_DISPATCH = std::numeric_limits<size_t>::max();
+        
+        using EventLane = TimedQueue<QueuedEvent>;
+        
+        struct LaneCounters {
+            size_t dispatched{0};
+            size_t starvedPasses{0};
+            size_t totalStarvedPasses{0};
+            double averageLatencyMs{0.};
+            double maxLatencyMs{0.};
+        };
+        
+        struct AsyncState {
+            std::shared_ptr<std::atomic_bool> cancelled{std::make_shared<std::atomic_bool>(false)};
+            mutable std::mutex mutex;
+            std::condition_variable finished;
+            size_t inFlight{0};
+        };
+        
+        //stable target for the SA::delegate, which only stores a pointer
+        struct AsyncDelegate {
+            AsyncDelegate(EventManager& o, AsyncEventHandler h):owner(o),handler(std::move(h)){}
+            EventStatus invoke(const IEventRef& event){ return owner.runAsync(handler, event); }
+            EventManager& owner;
+            AsyncEventHandler handler;
+        };
+        
+        EventStatus multicast(EventDelegateList& list, const IEventRef& event);
+        
+        EventStatus runAsync(const AsyncEventHandler& handler, const IEventRef& event);
         
-        void deferEvent(const IEventRef& event);
+        void dispatch(const IEventRef& event, EventPriority priority);
+        bool dispatchQueued(QueuedEvent& queued);
+        void routeThreaded(QueuedEvent& queued);
+        void dispatchTimed(const QueuedEvent& queued, EventPriority priority);
+        void processLanes();
+        void deferEvent(const IEventRef& event, EventPriority priority);
         
-        TimedQueue<IEventRef> mQueue;
-        TimedLockingQueue<IEventRef,1024> mThreadedQueue;
-        std::vector<IEventRef> mDeferedEvents;
+        int mMaxDequeueTime{TimedQueue<QueuedEvent>::NO_TIME_LIMIT};
+        size_t mLaneStarvationLimit{4};
+        size_t mLaneStarvationQuota{8};
+        size_t mLaneDispatchLimit{UNLIMITED_DISPATCH};
+        size_t mLaneDispatchCount{0};
+        std::chrono::steady_clock::time_point mLanePassTime;
+        bool mLatencyHistogramsEnabled{false};
+        std::map<type_id_t, EventLatencyHistograms> mLatencyHistograms;
+        std::array<EventLane, NUM_LANES> mLanes;
+        std::array<LaneCounters, NUM_LANES> mLaneCounters;
+        std::map<type_id_t, EventPriority> mEventPriorities;
+        ThreadedEventQueue mThreadedQueue;
+        std::vector<QueuedEvent> mDeferedEvents;
         std::map<type_id_t, EventDelegateList> mEvents;
+        EventRecordHook mRecordHook;
+        uint32_t mDispatchDepth{0};
+        std::list<AsyncDelegate> mAsyncDelegates;
+        std::shared_ptr<AsyncState> mAsyncState{std::make_shared<AsyncState>()};
+        JobSystem* mAsyncJobs{nullptr};
+#if defined(MS_ALLOW_DELEGATE_PROFILE)
+        DelegateProfiler mDelegateProfiler;
+#endif
     };
     
 }//end namespace mediasystem
@@ -0,0 +1,156 @@
+//
+//  EventRecorder.cpp
+//  ofxMediaSystem
+//
+
+#include "EventRecorder.h"
+#include "mediasystem/core/Scene.h"
+#include "mediasystem/events/SceneEvents.h"
+#include "mediasystem/util/Log.h"
+
+namespace mediasystem {
+    
+    namespace {
+        //native byte order, logs are meant to be replayed on the machine class they were captured on
+        template<typename T>
+        void writePod(std::ostream& stream, const T& val)
+        {
+            stream.write(reinterpret_cast<const char*>(&val), sizeof(T));
+        }
+    }
+    
+    bool EventSerializers::registerEvent(type_id_t type, Entry&& entry)
+    {
+        auto usedId = mIds.find(entry.id);
+        if(usedId != mIds.end() && usedId->second != type){
+            MS_LOG_ERROR("Event serializer id " + std::to_string(entry.id) + " is already registered to another event type");
+            return false;
+        }
+        auto found = mEntries.find(type);
+        if(found != mEntries.end()){
+            mIds.erase(found->second.id);
+        }
+        mIds[entry.id] = type;
+        mEntries[type] = std::move(entry);
+        return true;
+    }
+    
+    bool EventSerializers::serialize(const IEvent& event, uint32_t& id, std::string& out) const
+    {
+        auto found = mEntries.find(event.getType());
+        if(found == mEntries.end()){
+            return false;
+        }
+        id = found->second.id;
+        found->second.write(event, out);
+        return true;
+    }
+    
+    IEventRef EventSerializers::deserialize(uint32_t id, const std::string& in) const
+    {
+        auto foundId = mIds.find(id);
+        if(foundId == mIds.end()){
+            MS_LOG_ERROR("No event serializer registered for id " + std::to_string(id));
+            return nullptr;
+        }
+        return mEntries.at(foundId->second).read(in);
+    }
+    
+    EventRecorder::EventRecorder(const EventSerializers& serializers):
+    mSerializers(serializers)
+    {}
+    
+    EventRecorder::~EventRecorder()
+    {
+        stop();
+    }
+    
+    bool EventRecorder::start(const std::filesystem::path& path, Scene& scene)
+    {
+        if(!open(path, scene)){
+            return false;
+        }
+        mMarkSceneFrames = true;
+        return true;
+    }
+    
+    bool EventRecorder::start(const std::filesystem::path& path, EventManager& manager)
+    {
+        if(!open(path, manager)){
+            return false;
+        }
+        mMarkSceneFrames = false;
+        return true;
+    }
+    
+    bool EventRecorder::open(const std::filesystem::path& path, EventManager& manager)
+    {
+        stop();
+        
+        if(manager.hasRecordHook()){
+            MS_LOG_ERROR("Event manager is already being recorded");
+            return false;
+        }
+        
+        mStream.open(path, std::ios::binary | std::ios::trunc);
+        if(!mStream.is_open()){
+            MS_LOG_ERROR("Could not open event log for writing: " + path.string());
+            return false;
+        }
+        mStream.write(event_log::MAGIC, sizeof(event_log::MAGIC));
+        writePod(mStream, event_log::VERSION);
+        
+        mNumRecorded = 0;
+        mNumSkipped = 0;
+        mNumFrames = 0;
+        mManager = &manager;
+        mManager->setRecordHook([this](const IEventRef& event){ record(event); });
+        return true;
+    }
+    
+    void EventRecorder::stop()
+    {
+        if(mManager){
+            mManager->clearRecordHook();
+            mManager = nullptr;
+        }
+        if(mStream.is_open()){
+            mStream.close();
+        }
+    }
+    
+    void EventRecorder::markFrame(uint64_t frame, double time)
+    {
+        if(!mStream.is_open()){
+            return;
+        }
+        writePod(mStream, event_log::FRAME);
+        writePod(mStream, frame);
+        writePod(mStream, time);
+        ++mNumFrames;
+    }
+    
+    void EventRecorder::record(const IEventRef& event)
+    {
+        if(mMarkSceneFrames && event->getType() == type_id<Update>){
+            auto update = std::static_pointer_cast<Update>(event);
+            markFrame(update->getElapsedFrames(), update->getElapsedTime());
+            return;
+        }
+        
+        uint32_t id = 0;
+        mBuffer.clear();
+        if(!mSerializers.serialize(*event, id, mBuffer)){
+            ++mNumSkipped;
+            return;
+        }
+        
+        writePod(mStream, event_log::EVENT);
+        writePod(mStream, id);
+        writePod(mStream, event->getTopics());
+        writePod(mStream, static_cast<uint32_t>(mBuffer.size()));
+        mStream.write(mBuffer.data(), mBuffer.size());
+        ++mNumRecorded;
+    }
+    
+}//end namespace mediasystem
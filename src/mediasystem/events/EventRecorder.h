@@ -0,0 +1,111 @@
+//
+//  EventRecorder.h
+//  ofxMediaSystem
+//
+//  Binary event log, little more than a list of FRAME and EVENT records behind a "MSEV" header.
+//  Only event types with a registered serializer are written, everything else is counted and skipped.
+//
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <filesystem>
+#include "mediasystem/events/EventManager.h"
+
+namespace mediasystem {
+    
+    class Scene;
+    
+    namespace event_log {
+        static const char MAGIC[4] = {'M','S','E','V'};
+        static const uint32_t VERSION = 1;
+        enum RecordType : uint8_t {
+            FRAME = 1,  //uint64 frame, double time
+            EVENT = 2   //uint32 id, uint64 topics, uint32 size, bytes
+        };
+    }
+    
+    //ids are chosen by the application and must stay stable across builds, type_id_t values do not
+    class EventSerializers {
+    public:
+        
+        template<typename EventType>
+        using Writer = std::function<void(const EventType&, std::string&)>;
+        template<typename EventType>
+        using Reader = std::function<std::shared_ptr<EventType>(const std::string&)>;
+        
+        template<typename EventType>
+        bool registerEvent(uint32_t id, Writer<EventType> write, Reader<EventType> read){
+            static_assert( std::is_base_of<IEvent, EventType>::value, "EventType must derive from IEvent.");
+            Entry entry;
+            entry.id = id;
+            entry.write = [write](const IEvent& event, std::string& out){
+                write(static_cast<const EventType&>(event), out);
+            };
+            entry.read = [read](const std::string& in)->IEventRef{
+                return read(in);
+            };
+            return registerEvent(type_id<EventType>, std::move(entry));
+        }
+        
+        bool isRegistered(type_id_t type) const { return mEntries.find(type) != mEntries.end(); }
+        
+        //returns false if the event type has no serializer
+        bool serialize(const IEvent& event, uint32_t& id, std::string& out) const;
+        IEventRef deserialize(uint32_t id, const std::string& in) const;
+        
+    private:
+        
+        struct Entry {
+            uint32_t id;
+            std::function<void(const IEvent&, std::string&)> write;
+            std::function<IEventRef(const std::string&)> read;
+        };
+        
+        bool registerEvent(type_id_t type, Entry&& entry);
+        
+        std::map<type_id_t, Entry> mEntries;
+        std::map<uint32_t, type_id_t> mIds;
+    };
+    
+    //Records every serializable event an EventManager dispatches. Attached to a Scene the frame
+    //records come from its Update events, otherwise call markFrame() once per frame.
+    class EventRecorder {
+    public:
+        
+        explicit EventRecorder(const EventSerializers& serializers);
+        ~EventRecorder();
+        
+        EventRecorder(const EventRecorder&) = delete;
+        EventRecorder& operator=(const EventRecorder&) = delete;
+        
+        bool start(const std::filesystem::path& path, Scene& scene);
+        bool start(const std::filesystem::path& path, EventManager& manager);
+        void stop();
+        
+        void markFrame(uint64_t frame, double time);
+        
+        inline bool isRecording() const { return mManager != nullptr; }
+        inline size_t getNumRecordedEvents() const { return mNumRecorded; }
+        inline size_t getNumSkippedEvents() const { return mNumSkipped; }
+        inline size_t getNumFrames() const { return mNumFrames; }
+        
+    private:
+        
+        bool open(const std::filesystem::path& path, EventManager& manager);
+        void record(const IEventRef& event);
+        
+        const EventSerializers& mSerializers;
+        EventManager* mManager{nullptr};
+        bool mMarkSceneFrames{false};
+        std::ofstream mStream;
+        std::string mBuffer;
+        size_t mNumRecorded{0};
+        size_t mNumSkipped{0};
+        size_t mNumFrames{0};
+    };
+    
+}//end namespace mediasystem
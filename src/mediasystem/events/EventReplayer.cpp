@@ -0,0 +1,147 @@
+//
+//  EventReplayer.cpp
+//  ofxMediaSystem
+//
+
+#include "EventReplayer.h"
+#include <chrono>
+#include <cstring>
+#include "mediasystem/core/SceneManager.h"
+#include "mediasystem/util/Log.h"
+
+namespace mediasystem {
+    
+    namespace {
+        template<typename T>
+        bool readPod(std::istream& stream, T& val)
+        {
+            return static_cast<bool>(stream.read(reinterpret_cast<char*>(&val), sizeof(T)));
+        }
+    }
+    
+    EventReplayer::EventReplayer(const EventSerializers& serializers):
+    mSerializers(serializers)
+    {}
+    
+    bool EventReplayer::load(const std::filesystem::path& path)
+    {
+        mFrames.clear();
+        mCurrent = 0;
+        
+        std::ifstream stream(path, std::ios::binary);
+        if(!stream.is_open()){
+            MS_LOG_ERROR("Could not open event log: " + path.string());
+            return false;
+        }
+        
+        char magic[sizeof(event_log::MAGIC)];
+        uint32_t version = 0;
+        if(!stream.read(magic, sizeof(magic)) || std::memcmp(magic, event_log::MAGIC, sizeof(magic)) != 0 || !readPod(stream, version)){
+            MS_LOG_ERROR("Not an event log: " + path.string());
+            return false;
+        }
+        if(version != event_log::VERSION){
+            MS_LOG_ERROR("Unsupported event log version " + std::to_string(version));
+            return false;
+        }
+        
+        //events recorded before the first frame record are replayed with the first frame
+        mFrames.emplace_back();
+        bool sawFrame = false;
+        
+        uint8_t type = 0;
+        while(readPod(stream, type)){
+            switch(type){
+                case event_log::FRAME:{
+                    RecordedFrame frame;
+                    if(!readPod(stream, frame.frame) || !readPod(stream, frame.time)){
+                        MS_LOG_WARNING("Event log truncated in a frame record");
+                        break;
+                    }
+                    if(!sawFrame){
+                        mFrames.back().frame = frame.frame;
+                        mFrames.back().time = frame.time;
+                        sawFrame = true;
+                    }else{
+                        mFrames.emplace_back(std::move(frame));
+                    }
+                }break;
+                case event_log::EVENT:{
+                    RecordedEvent event;
+                    uint32_t size = 0;
+                    if(!readPod(stream, event.id) || !readPod(stream, event.topics) || !readPod(stream, size)){
+                        MS_LOG_WARNING("Event log truncated in an event record");
+                        break;
+                    }
+                    event.data.resize(size);
+                    if(size && !stream.read(&event.data[0], size)){
+                        MS_LOG_WARNING("Event log truncated in an event record");
+                        break;
+                    }
+                    mFrames.back().events.emplace_back(std::move(event));
+                }break;
+                default:
+                    MS_LOG_ERROR("Corrupt event log, unknown record type " + std::to_string(type));
+                    mFrames.clear();
+                    return false;
+            }
+        }
+        
+        if(!sawFrame){
+            MS_LOG_WARNING("Event log has no frame records: " + path.string());
+        }
+        return true;
+    }
+    
+    bool EventReplayer::step(SceneManager& scenes, EventManager& target, ReplayFrameStats* stats)
+    {
+        if(isFinished()){
+            return false;
+        }
+        
+        auto& frame = mFrames[mCurrent++];
+        
+        std::vector<IEventRef> events;
+        events.reserve(frame.events.size());
+        for(auto & recorded : frame.events){
+            auto event = mSerializers.deserialize(recorded.id, recorded.data);
+            if(event){
+                event->setTopics(recorded.topics);
+                events.emplace_back(std::move(event));
+            }
+        }
+        
+        auto begin = std::chrono::steady_clock::now();
+        for(auto & event : events){
+            target.queueEvent(std::move(event));
+        }
+        scenes.update(static_cast<float>(frame.time), frame.frame);
+        auto end = std::chrono::steady_clock::now();
+        
+        if(stats){
+            stats->frame = frame.frame;
+            stats->time = frame.time;
+            stats->numEvents = events.size();
+            stats->updateMs = std::chrono::duration<double, std::milli>(end - begin).count();
+        }
+        return true;
+    }
+    
+    ReplayStats EventReplayer::run(SceneManager& scenes, EventManager& target)
+    {
+        ReplayStats stats;
+        stats.frames.reserve(mFrames.size() - mCurrent);
+        ReplayFrameStats frame;
+        while(step(scenes, target, &frame)){
+            stats.frames.push_back(frame);
+            stats.frameCost.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>(frame.updateMs)));
+            stats.numEvents += frame.numEvents;
+            stats.totalMs += frame.updateMs;
+            stats.maxMs = std::max(stats.maxMs, frame.updateMs);
+        }
+        stats.numFrames = stats.frames.size();
+        stats.meanMs = stats.numFrames ? stats.totalMs / stats.numFrames : 0.;
+        return stats;
+    }
+    
+}//end namespace mediasystem
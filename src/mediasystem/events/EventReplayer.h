@@ -0,0 +1,75 @@
+//
+//  EventReplayer.h
+//  ofxMediaSystem
+//
+//  Replays an EventRecorder log headlessly: each recorded frame queues its events into the target
+//  and calls SceneManager::update with the recorded frame and time, measuring the update cost.
+//
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <filesystem>
+#include "mediasystem/events/EventRecorder.h"
+#include "mediasystem/util/LatencyHistogram.hpp"
+
+namespace mediasystem {
+    
+    class SceneManager;
+    
+    struct ReplayFrameStats {
+        uint64_t frame{0};
+        double time{0.};
+        size_t numEvents{0};
+        double updateMs{0.};
+    };
+    
+    struct ReplayStats {
+        size_t numFrames{0};
+        size_t numEvents{0};
+        double totalMs{0.};
+        double meanMs{0.};
+        double maxMs{0.};
+        LatencyHistogram frameCost;
+        std::vector<ReplayFrameStats> frames;
+    };
+    
+    class EventReplayer {
+    public:
+        
+        explicit EventReplayer(const EventSerializers& serializers);
+        
+        bool load(const std::filesystem::path& path);
+        
+        inline size_t getNumFrames() const { return mFrames.size(); }
+        inline size_t getCurrentFrame() const { return mCurrent; }
+        inline bool isFinished() const { return mCurrent >= mFrames.size(); }
+        inline void rewind(){ mCurrent = 0; }
+        
+        //replays one frame, events are deserialized before the timed update
+        bool step(SceneManager& scenes, EventManager& target, ReplayFrameStats* stats = nullptr);
+        
+        //replays every remaining frame
+        ReplayStats run(SceneManager& scenes, EventManager& target);
+        
+    private:
+        
+        struct RecordedEvent {
+            uint32_t id;
+            EventTopicMask topics;
+            std::string data;
+        };
+        
+        struct RecordedFrame {
+            uint64_t frame{0};
+            double time{0.};
+            std::vector<RecordedEvent> events;
+        };
+        
+        const EventSerializers& mSerializers;
+        std::vector<RecordedFrame> mFrames;
+        size_t mCurrent{0};
+    };
+    
+}//end namespace mediasystem
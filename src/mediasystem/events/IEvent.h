@@ -14,9 +14,22 @@ namespace mediasystem {
 
     using IEventRef = std::shared_ptr<struct IEvent>;
     
+    //events and subscribers both carry a topic mask, an event is routed when the masks intersect
+    using EventTopicMask = uint64_t;
+    static const EventTopicMask ALL_EVENT_TOPICS = ~EventTopicMask(0);
+    
+    inline constexpr EventTopicMask eventTopic(uint32_t index){ return EventTopicMask(1) << index; }
+    
     struct IEvent {
         virtual ~IEvent() = default;
         virtual type_id_t getType() const = 0;
+        
+        //set before the event is queued, queued events are shared between receivers
+        void setTopics(EventTopicMask topics){ mTopics = topics; }
+        EventTopicMask getTopics() const { return mTopics; }
+        
+    private:
+        EventTopicMask mTopics{ALL_EVENT_TOPICS};
     };
     
     template<typename EventType>
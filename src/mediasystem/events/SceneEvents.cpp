@@ -16,7 +16,7 @@ namespace mediasystem {
         mOrder(order)
     {}
     
-    SceneChange::SceneChange(Scene& current_scene, std::shared_ptr<Scene> next_scene):
+    SceneChange::SceneChange(Scene& current_scene, StrongHandle<Scene> next_scene):
         SceneEvent<SceneChange>(current_scene),
         mNextScene(std::move(next_scene))
     {
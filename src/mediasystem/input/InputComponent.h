@@ -8,6 +8,7 @@
 #pragma once
 #include <memory>
 #include "mediasystem/events/IEvent.h"
+#include "mediasystem/core/Handle.h"
 #include "ofMain.h"
 
 namespace mediasystem {
@@ -95,7 +96,7 @@ namespace mediasystem {
     private:
         
         Entity& mContext;
-        std::weak_ptr<ofNode> mNode;
+        Handle<ofNode> mNode;
         bool mHovering{false};
         bool mPressed{false};
         int mZIndex{0};
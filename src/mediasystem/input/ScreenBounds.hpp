@@ -58,8 +58,8 @@ namespace mediasystem {
     };
     
     struct ScreenBoundsDebug {
-        ScreenBoundsDebug(std::shared_ptr<ScreenBounds> comp):input(comp){}
-        std::shared_ptr<ScreenBounds> input;
+        ScreenBoundsDebug(StrongHandle<ScreenBounds> comp):input(comp){}
+        StrongHandle<ScreenBounds> input;
         void draw(){
             ofPushStyle();
             ofNoFill();
@@ -26,14 +26,17 @@ namespace mediasystem {
     {
         auto update = std::static_pointer_cast<Update>(event);
         
+        //both upload textures, so this stays on the main thread. next() holds a handle to the
+        //current component, so playback callbacks can remove the component that is updating.
         auto it = mVideoPlayers.iter();
         while (auto video = it.next()) {
             video->update();
         }
         
+        auto lastFrameTime = update->getLastFrameTime();
         auto seqit = mImageSequences.iter();
         while (auto seq = seqit.next()) {
-            seq->update(update->getLastFrameTime());
+            seq->update(lastFrameTime);
         }
         
         return EventStatus::SUCCESS;
@@ -0,0 +1,160 @@
+//
+//  FrameCache.cpp
+//  ofxMediaSystem
+//
+
+#include "FrameCache.h"
+
+namespace mediasystem {
+
+    size_t FrameCache::KeyHash::operator()(const Key& key) const
+    {
+        auto hash = std::hash<std::string>()(key.path);
+        hash ^= (static_cast<size_t>(key.frame) << 1) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= static_cast<size_t>(key.decodeParams) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+
+    FrameCache::FrameCache(size_t budgetBytes):
+        mBudget(budgetBytes)
+    {}
+
+    FrameCache::PixelsRef FrameCache::find(const Key& key)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return findLocked(key);
+    }
+
+    FrameCache::PixelsRef FrameCache::insert(const Key& key, ofPixels&& pixels)
+    {
+        auto ref = std::make_shared<const ofPixels>(std::move(pixels));
+        std::lock_guard<std::mutex> lock(mMutex);
+        return insertLocked(key, std::move(ref));
+    }
+
+    FrameCache::PixelsRef FrameCache::load(const Key& key, const std::filesystem::path& file)
+    {
+        std::shared_ptr<Decode> decode;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            auto found = mLookup.find(key);
+            if(found != mLookup.end()){
+                ++mHits;
+                mEntries.splice(mEntries.begin(), mEntries, found->second);
+                return found->second->pixels;
+            }
+            auto decoding = mDecoding.find(key);
+            if(decoding != mDecoding.end()){
+                ++mHits;
+                auto pending = decoding->second;
+                mDecodeCondition.wait(lock, [&pending]{ return pending->done; });
+                return pending->pixels;
+            }
+            ++mMisses;
+            decode = std::make_shared<Decode>();
+            mDecoding.emplace(key, decode);
+        }
+        
+        PixelsRef ref;
+        ofPixels pixels;
+        if(ofLoadImage(pixels, file))
+            ref = std::make_shared<const ofPixels>(std::move(pixels));
+        
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(ref)
+                ref = insertLocked(key, std::move(ref));
+            decode->pixels = ref;
+            decode->done = true;
+            mDecoding.erase(key);
+        }
+        mDecodeCondition.notify_all();
+        return ref;
+    }
+
+    FrameCache::PixelsRef FrameCache::findLocked(const Key& key)
+    {
+        auto found = mLookup.find(key);
+        if(found == mLookup.end()){
+            ++mMisses;
+            return nullptr;
+        }
+        ++mHits;
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+        return found->second->pixels;
+    }
+
+    FrameCache::PixelsRef FrameCache::insertLocked(const Key& key, PixelsRef pixels)
+    {
+        auto found = mLookup.find(key);
+        if(found != mLookup.end()){
+            mEntries.splice(mEntries.begin(), mEntries, found->second);
+            return found->second->pixels;
+        }
+        auto numBytes = pixels->getTotalBytes();
+        mEntries.push_front(Entry{key, pixels, numBytes});
+        mLookup.emplace(key, mEntries.begin());
+        mNumBytes += numBytes;
+        evict();
+        return pixels;
+    }
+
+    void FrameCache::setBudget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBudget = bytes;
+        evict();
+    }
+
+    size_t FrameCache::getBudget() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mBudget;
+    }
+
+    void FrameCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto budget = mBudget;
+        mBudget = 0;
+        evict();
+        mBudget = budget;
+    }
+
+    FrameCacheStats FrameCache::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        FrameCacheStats stats;
+        stats.hits = mHits;
+        stats.misses = mMisses;
+        stats.evictions = mEvictions;
+        stats.numFrames = mEntries.size();
+        stats.numBytes = mNumBytes;
+        stats.budget = mBudget;
+        return stats;
+    }
+
+    void FrameCache::resetStats()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mHits = 0;
+        mMisses = 0;
+        mEvictions = 0;
+    }
+
+    void FrameCache::evict()
+    {
+        //walks from the least recently used end, frames held elsewhere stay put
+        auto it = mEntries.end();
+        while(mNumBytes > mBudget && it != mEntries.begin()){
+            --it;
+            if(it->pixels.use_count() > 1)
+                continue;
+            mNumBytes -= it->numBytes;
+            mLookup.erase(it->key);
+            it = mEntries.erase(it);
+            ++mEvictions;
+        }
+    }
+
+}//end namespace mediasystem
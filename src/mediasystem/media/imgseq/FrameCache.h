@@ -0,0 +1,110 @@
+//
+//  FrameCache.h
+//  ofxMediaSystem
+//
+//  Decoded image sequence frames shared between every ImageSequence reading the same files. Entries
+//  are reference counted, the cache keeps recently used frames alive up to a byte budget and evicts
+//  the least recently used frames nobody else holds once it is exceeded. Safe from any thread.
+//
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+#include <string>
+#include <filesystem>
+#include <unordered_map>
+#include "ofMain.h"
+#include "mediasystem/util/Singleton.hpp"
+
+namespace mediasystem {
+
+    struct FrameCacheStats {
+        size_t hits{0};
+        size_t misses{0};
+        size_t evictions{0};
+        size_t numFrames{0};
+        size_t numBytes{0};
+        size_t budget{0};
+    };
+
+    class FrameCache {
+    public:
+
+        using PixelsRef = std::shared_ptr<const ofPixels>;
+
+        //frames are identified by the source they were decoded from and how they were decoded
+        struct Key {
+            std::string path;
+            uint32_t frame{0};
+            uint32_t decodeParams{0};
+            bool operator==(const Key& other) const { return frame == other.frame && decodeParams == other.decodeParams && path == other.path; }
+        };
+
+        static constexpr size_t DEFAULT_BUDGET = 512 * 1024 * 1024;
+
+        explicit FrameCache(size_t budgetBytes = DEFAULT_BUDGET);
+
+        //non copyable
+        FrameCache(const FrameCache&) = delete;
+        FrameCache& operator=(const FrameCache&) = delete;
+
+        //nullptr on a miss
+        PixelsRef find(const Key& key);
+        //returns the cached frame instead if another thread inserted the same key first
+        PixelsRef insert(const Key& key, ofPixels&& pixels);
+        //Find, or decode file with ofLoadImage outside the lock and insert, nullptr if decoding failed.
+        //A load of a frame another thread is already decoding waits for that decode and counts as a hit.
+        PixelsRef load(const Key& key, const std::filesystem::path& file);
+
+        //frames still held outside the cache can't be evicted and may keep it over budget
+        void setBudget(size_t bytes);
+        size_t getBudget() const;
+
+        //drops every frame nobody else holds
+        void clear();
+
+        FrameCacheStats getStats() const;
+        void resetStats();
+
+    private:
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const;
+        };
+
+        struct Entry {
+            Key key;
+            PixelsRef pixels;
+            size_t numBytes{0};
+        };
+
+        struct Decode {
+            PixelsRef pixels;
+            bool done{false};
+        };
+        
+        //caller holds mMutex
+        PixelsRef findLocked(const Key& key);
+        PixelsRef insertLocked(const Key& key, PixelsRef pixels);
+        void evict();
+
+        mutable std::mutex mMutex;
+        //most recently used first
+        std::list<Entry> mEntries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> mLookup;
+        std::unordered_map<Key, std::shared_ptr<Decode>, KeyHash> mDecoding;
+        std::condition_variable mDecodeCondition;
+        size_t mBudget{DEFAULT_BUDGET};
+        size_t mNumBytes{0};
+        size_t mHits{0};
+        size_t mMisses{0};
+        size_t mEvictions{0};
+    };
+
+    //shared by every ImageSequence that isn't handed a FrameCache, DefaultFrameCache::init(bytes) sets the budget
+    using DefaultFrameCache = Singleton<FrameCache>;
+
+}//end namespace mediasystem
@@ -2,7 +2,6 @@
 #include "ImageSequence.h"
 #include <algorithm>
 #include "mediasystem/util/Log.h"
-#include "mediasystem/util/LockingQueue.hpp"
 #include "ofMain.h"
 
 using namespace std;
@@ -10,14 +9,30 @@ using namespace std::chrono;
 
 namespace mediasystem {
     
-    ImageSequenceBase::ImageSequenceBase(std::filesystem::path&& pathToImgDir, float fps, const Playable<uint32_t>::Options& options) :
+    ImageSequenceBase::ImageSequenceBase(std::filesystem::path&& pathToImgDir, float fps, const Playable<uint32_t>::Options& options, FrameCache* frameCache) :
         Playable<uint32_t>(0),
         mImagesDir(std::move(pathToImgDir)),
-        mFramerate(fps)
+        mFramerate(fps),
+        mFrameCache(frameCache)
     {
         mInvFps = 1.f / mFramerate;
-        parseSource(pathToImgDir, mSeqPaths);
-        Playable<uint32_t>::init(mSeqPaths.size()-1,options);
+        if(mFrameCache){
+            std::error_code ec;
+            auto canonical = std::filesystem::weakly_canonical(mImagesDir, ec);
+            mCacheKeyPath = ec ? mImagesDir.string() : canonical.string();
+        }
+        parseSource(mImagesDir, mSeqPaths);
+        if(mSeqPaths.size() == 1 && mSeqPaths.front().extension() == packed_frames::EXTENSION){
+            auto packed = std::make_shared<PackedFrameReader>();
+            if(packed->open(mSeqPaths.front())){
+                mPackedFrames = std::move(packed);
+            }else{
+                //not an image ofLoadImage could decode either
+                mSeqPaths.clear();
+            }
+        }
+        auto numFrames = getNumSourceFrames();
+        Playable<uint32_t>::init(numFrames ? numFrames - 1 : 0, options);
     }
     
     void ImageSequenceBase::update(float amount){
@@ -30,6 +45,46 @@ namespace mediasystem {
         }
     }
     
+    FrameCache::PixelsRef ImageSequenceBase::loadFrame(uint32_t index)
+    {
+        if(mPackedFrames)
+            return loadPackedFrame(index);
+        if(index >= mSeqPaths.size())
+            return nullptr;
+        FrameCache::PixelsRef pixels;
+        if(mFrameCache){
+            pixels = mFrameCache->load({mCacheKeyPath, index, 0}, mSeqPaths[index]);
+        }else{
+            auto decoded = std::make_shared<ofPixels>();
+            if(ofLoadImage(*decoded, mSeqPaths[index]))
+                pixels = std::move(decoded);
+        }
+        if(!pixels){
+            MS_LOG_ERROR("Could not load image sequence frame: " + mSeqPaths[index].string());
+        }
+        return pixels;
+    }
+    
+    //Packed frames skip the frame cache, raw frames are already shared through the OS page cache and
+    //compressed ones are cheap enough to decompress again.
+    FrameCache::PixelsRef ImageSequenceBase::loadPackedFrame(uint32_t index)
+    {
+        //raw frames are handed out in place, the pixels keep the mapping alive
+        if(auto data = mPackedFrames->getFrameData(index)){
+            //faults the frame in here rather than during the texture upload
+            mPackedFrames->prefetch(index);
+            auto pixels = new ofPixels();
+            pixels->setFromExternalPixels(data, mPackedFrames->getWidth(), mPackedFrames->getHeight(), mPackedFrames->getNumChannels());
+            auto reader = mPackedFrames;
+            return FrameCache::PixelsRef(pixels, [reader](const ofPixels* pixels){ delete pixels; });
+        }
+        auto pixels = std::make_shared<ofPixels>();
+        if(mPackedFrames->readFrame(index, *pixels))
+            return pixels;
+        MS_LOG_ERROR("Could not read frame " << index << " of packed image sequence: " << mPackedFrames->getFile().string());
+        return nullptr;
+    }
+    
     void ImageSequenceBase::bind()
     {
         if(auto tex = getCurrentTexture()){
@@ -48,6 +103,15 @@ namespace mediasystem {
     {
         imageFiles.clear();
         
+        if (std::filesystem::is_regular_file(path)) {
+            if(PackedFrameReader::isPackedFile(path)){
+                imageFiles.push_back(path);
+            }else{
+                MS_LOG_ERROR("Image sequence file is not a packed frame file: " + path.string());
+            }
+            return;
+        }
+        
         if (std::filesystem::exists(path)) {
             std::filesystem::directory_iterator end_itr;
             for (std::filesystem::directory_iterator itr(path); itr != end_itr; ++itr)
@@ -67,47 +131,166 @@ namespace mediasystem {
         std::stable_sort(imageFiles.begin(), imageFiles.end());
     }
     
+    //Decodes frames into pixels on jobs and uploads them to textures in order on the loading thread.
+    //At most DECODE_WINDOW_PER_THREAD frames per thread are decoded ahead of the upload so pixels
+    //don't pile up for the whole sequence. Without a GL renderer the pixels are kept instead, shared
+    //through the FrameCache with any other sequence reading the same frames.
     class PreloadImpl : public ImageSequenceBase {
     public:
         
-        PreloadImpl(std::filesystem::path&& pathToImgDir, float fps, const Playable::Options& options): ImageSequenceBase(std::move(pathToImgDir), fps, std::move(options))
+        PreloadImpl(std::filesystem::path&& pathToImgDir, float fps, const Playable::Options& options, FrameCache* frameCache, JobSystem& jobs, bool async, size_t maxUploadsPerUpdate, LoadProgressFn progress):
+            ImageSequenceBase(std::move(pathToImgDir), fps, std::move(options), frameCache),
+            mJobSystem(jobs),
+            mAsyncLoad(async),
+            mMaxUploadsPerUpdate(maxUploadsPerUpdate),
+            mLoadProgressFn(std::move(progress))
         {
             load();
         }
         
+        ~PreloadImpl()
+        {
+            cancelLoad();
+        }
+        
         void load()override{
             if(!mImagesDir.empty()){
-                mImages.clear();
-                for ( auto & path : mSeqPaths ) {
-                    ofImage surface;
-                    surface.load(path);
-                    mImages.push_back(surface);
-                }
+                cancelLoad();
+                auto count = getNumSourceFrames();
+                mTextures.clear();
+                mTextures.resize(count);
+                mPixels.clear();
+                mPixels.resize(count);
+                mDecodeJobs.clear();
+                mDecodeJobs.resize(count);
+                mNumScheduled = 0;
+                mNumUploaded = 0;
+                mSize = glm::vec2(0);
+                mUploadTextures = ofGetGLRenderer() != nullptr;
+                mCancelDecode = false;
+                mIsInit = false;
+                mIsLoading = true;
                 reset();
-                mIsInit = true;
+                scheduleDecodes();
+                uploadFrames(mAsyncLoad ? mMaxUploadsPerUpdate : count);
+                //the loading thread decodes too while it waits on the next frame to upload
+                while(!mAsyncLoad && mIsLoading){
+                    mJobSystem.wait(mDecodeJobs[mNumUploaded]);
+                    uploadFrames(count);
+                }
             }
         }
         
+        void update(float amount)override{
+            if(mIsLoading)
+                uploadFrames(mMaxUploadsPerUpdate);
+            ImageSequenceBase::update(amount);
+        }
+        
+        float getLoadProgress() const override {
+            if(mTextures.empty())
+                return mIsInit ? 1.f : 0.f;
+            return mNumUploaded / static_cast<float>(mTextures.size());
+        }
+        
+        //frames still uploading show the last uploaded one
         ofTexture* getCurrentTexture()override {
-            return !mImages.empty() ? &mImages[getCurrentPosition() < mImages.size() ? getCurrentPosition() : mImages.size()-1].getTexture() : nullptr;
+            if(!mUploadTextures || mNumUploaded == 0)
+                return nullptr;
+            return &mTextures[std::min<size_t>(getCurrentPosition(), mNumUploaded - 1)];
         }
         
         glm::vec2 getSize() const override {
-            if(!mImages.empty()){
-                return glm::vec2(mImages.front().getWidth(), mImages.front().getHeight());
-            }
-            return glm::vec2(0);
+            return mSize;
         }
         
     private:
-        std::vector<ofImage> mImages;
+        
+        static const size_t DECODE_WINDOW_PER_THREAD = 4;
+        
+        void scheduleDecodes()
+        {
+            auto window = DECODE_WINDOW_PER_THREAD * (mJobSystem.getNumWorkers() + 1);
+            while(mNumScheduled < mDecodeJobs.size() && mNumScheduled - mNumUploaded < window){
+                auto index = mNumScheduled++;
+                mDecodeJobs[index] = mJobSystem.schedule([this, index]{ decodeFrame(index); });
+            }
+        }
+        
+        void decodeFrame(size_t index)
+        {
+            if(mCancelDecode.load(std::memory_order_relaxed))
+                return;
+            mPixels[index] = loadFrame(index);
+        }
+        
+        //uploads decoded frames in order until one isn't ready or maxFrames were uploaded
+        void uploadFrames(size_t maxFrames)
+        {
+            auto count = mDecodeJobs.size();
+            size_t uploaded = 0;
+            //an unscheduled slot's empty handle also counts as done, only scheduled frames can be taken
+            while(mNumUploaded < mNumScheduled && uploaded < maxFrames && mDecodeJobs[mNumUploaded].isDone()){
+                auto& pixels = mPixels[mNumUploaded];
+                if(mNumUploaded == 0 && pixels)
+                    mSize = glm::vec2(pixels->getWidth(), pixels->getHeight());
+                //the cache keeps the pixels for other sequences as long as its budget allows
+                if(mUploadTextures && pixels){
+                    mTextures[mNumUploaded].allocate(*pixels);
+                    pixels.reset();
+                }
+                mDecodeJobs[mNumUploaded].reset();
+                ++mNumUploaded;
+                ++uploaded;
+                if(mLoadProgressFn)
+                    mLoadProgressFn(mNumUploaded, count);
+            }
+            if(mNumUploaded < count){
+                scheduleDecodes();
+                return;
+            }
+            mDecodeJobs.clear();
+            mDecodeJobs.shrink_to_fit();
+            if(mUploadTextures){
+                mPixels.clear();
+                mPixels.shrink_to_fit();
+            }
+            mIsLoading = false;
+            mIsInit = true;
+        }
+        
+        //the decode jobs write into mPixels, they have to be done before it is touched
+        void cancelLoad()
+        {
+            if(!mIsLoading)
+                return;
+            mCancelDecode = true;
+            std::vector<JobHandle> pending(mDecodeJobs.begin() + mNumUploaded, mDecodeJobs.begin() + mNumScheduled);
+            mJobSystem.wait(pending);
+            mIsLoading = false;
+        }
+        
+        JobSystem& mJobSystem;
+        bool mAsyncLoad{false};
+        size_t mMaxUploadsPerUpdate{4};
+        LoadProgressFn mLoadProgressFn;
+        
+        std::vector<ofTexture> mTextures;
+        std::vector<FrameCache::PixelsRef> mPixels;
+        std::vector<JobHandle> mDecodeJobs;
+        size_t mNumScheduled{0};
+        size_t mNumUploaded{0};
+        glm::vec2 mSize{0};
+        bool mUploadTextures{true};
+        bool mIsLoading{false};
+        std::atomic<bool> mCancelDecode{false};
     };
     
     
     struct Frame {
-        Frame():img(nullptr),frame(0),serial(0),finished(false){}
-        Frame(uint32_t f, const std::shared_ptr<ofImage>& d, uint32_t s, bool fin):img(d),frame(f),serial(s),finished(fin){}
-        std::shared_ptr<ofImage> img;
+        Frame():pixels(nullptr),frame(0),serial(0),finished(false){}
+        Frame(uint32_t f, const FrameCache::PixelsRef& d, uint32_t s, bool fin):pixels(d),frame(f),serial(s),finished(fin){}
+        FrameCache::PixelsRef pixels;
         uint32_t frame;
         uint32_t serial;
         bool finished;
@@ -145,17 +328,20 @@ namespace mediasystem {
     class StreamingImpl : public ImageSequenceBase {
     public:
         
-        StreamingImpl(std::filesystem::path&& pathToImgsDir,  float framerate, const Playable::Options& options) :
-            ImageSequenceBase(std::move(pathToImgsDir), framerate, options)
+        StreamingImpl(std::filesystem::path&& pathToImgsDir,  float framerate, const Playable::Options& options, FrameCache* frameCache, JobSystem& jobs, size_t readAhead, size_t decodeThreads) :
+            ImageSequenceBase(std::move(pathToImgsDir), framerate, options, frameCache),
+            mReadAhead(std::max<size_t>(readAhead, 1)),
+            mDecodeThreads(std::max<size_t>(decodeThreads, 1)),
+            mJobSystem(jobs)
         {
             mLoadingState = mState;
-            startDataLoadingThread();
+            startLoader();
             load();
         }
         
         ~StreamingImpl()
         {
-            stopDataLoadingThread();
+            stopLoader();
         }
         
         void step(uint32_t frames) override
@@ -178,22 +364,22 @@ namespace mediasystem {
                     auto expectedState = Playable<uint32_t>::State::advance(mState,frames);
                     
                     while(true){
-                        auto success = mQueue.tryPop(retrieve);
+                        auto success = tryPopFrame(retrieve);
                         if(success){
                             
                             if(retrieve.serial != mSerial) //pop until we find one thats current
                                 continue;
                             
-                            if(retrieve.img){
+                            if(retrieve.pixels){
                                 if(retrieve.frame != expectedState.currentPosition){
                                     //this should never happen
                                     MS_LOG_ERROR("popped an out of order frame off the queue, should have been " << expectedState.currentPosition << "but received " << retrieve.frame);
                                 }
                                 mState.currentPosition = retrieve.frame;
-                                mCurrentImage.allocate(retrieve.img->getPixels());
+                                mCurrentImage.allocate(*retrieve.pixels);
                                 
                                 if(retrieve.finished){
-                                    ofLogNotice() << mSeqPaths[0].string() << " finished!";
+                                    ofLogNotice() << mImagesDir.string() << " finished!";
                                     mState.setFinished();
                                     ImageSequenceBase::stop();
                                     if(mHandlersMap[ON_FINISH_HANDLER])
@@ -304,7 +490,7 @@ namespace mediasystem {
             if(isPlaying() && !isPaused()) return;
             Playable::play();
             flushQueue();
-            ofLogNotice() << mSeqPaths[0].string() << " starting!";
+            ofLogNotice() << mImagesDir.string() << " starting!";
         }
         
         void load()override{
@@ -312,10 +498,8 @@ namespace mediasystem {
                 mCurrentImage.clear();
                 reset();
                 //load first frame
-                ofImage img;
-                img.setUseTexture(false);
-                img.load(mSeqPaths[mState.currentPosition]);
-                mCurrentImage.allocate(img.getPixels());
+                if(auto pixels = loadFrame(mState.currentPosition))
+                    mCurrentImage.allocate(*pixels);
                 mIsInit = true;
             }
         }
@@ -329,6 +513,8 @@ namespace mediasystem {
             return glm::vec2(mCurrentImage.getWidth(), mCurrentImage.getHeight());
         }
         
+        uint32_t getNumMissedFrames() const override { return mMissedFrames; }
+        
         void setLoop( const bool flag = true )override{
             mState.setLoop(flag);
             flushQueue();
@@ -368,80 +554,123 @@ namespace mediasystem {
         
     private:
         
+        struct PendingFrame {
+            Frame frame;
+            bool ready{false};
+        };
+        
+        //Re-serials the frames in the window that still follow the current state and drops the rest,
+        //decodes in flight for dropped frames finish into nothing.
         void flushQueue()
         {
             {
                 std::lock_guard<std::mutex> lock(mPlaystateMutex);
                 mLoadingState = mState;
                 ++mSerial;
-                auto count = mQueue.size();
                 Playable::State tmp = mState;
-                for(size_t i = 0; i < count; i++){
+                for(size_t i = 0; i < mWindow.size(); i++){
                     tmp = Playable::State::advance(tmp, 1);
-                    auto frame = mQueue.peek(i);
-                    if(frame->frame == tmp.currentPosition){
-                        frame->serial = mSerial;
-                        frame->finished = tmp.isFinished();
+                    auto& pending = *mWindow[i];
+                    if(pending.frame.frame == tmp.currentPosition){
+                        pending.frame.serial = mSerial;
+                        pending.frame.finished = tmp.isFinished();
                         mLoadingState = tmp;
                     }else{
-                        mQueue.flush(i);
+                        mWindow.erase(mWindow.begin() + i, mWindow.end());
                         break;
                     }
                 }
             }
+            kickLoader();
         }
         
-        void startDataLoadingThread()
+        void startLoader()
         {
-            if(!mDataLoadingThreadRunning && !mDataLoadingThread){
-                mDataLoadingThreadRunning = true;
-                mDataLoadingThread.reset( new std::thread(&StreamingImpl::dataLoadingThread, this));
+            if(!mLoaderRunning){
+                mLoaderRunning = true;
+                kickLoader();
             }
         }
         
-        void stopDataLoadingThread()
+        void stopLoader()
         {
-            if(mDataLoadingThreadRunning && mDataLoadingThread){
-                mDataLoadingThreadRunning = false;
-                mQueue.abort();
-                mDataLoadingThread->join();
-                mDataLoadingThread.reset();
+            if(mLoaderRunning){
+                std::vector<JobHandle> decodes;
+                {
+                    std::lock_guard<std::mutex> lock(mPlaystateMutex);
+                    mLoaderRunning = false;
+                    decodes.assign(mDecodeJobs.begin(), mDecodeJobs.end());
+                    mDecodeJobs.clear();
+                }
+                mJobSystem.wait(decodes);
             }
         }
         
-        void dataLoadingThread()
+        void kickLoader()
         {
-            while(mDataLoadingThreadRunning){
-                uint32_t curFrame = 0;
-                uint32_t serial = 0;
-                bool fin = false;
-                {
-                    std::lock_guard<std::mutex> lock(mPlaystateMutex);
-                    mLoadingState = Playable::State::advance( mLoadingState, 1 );
-                    curFrame = mLoadingState.currentPosition;
-                    serial = mSerial;
-                    fin = mLoadingState.isFinished();
-                    if(fin){
-                        mLoadingState.setFinished(false);
-                    }
+            std::lock_guard<std::mutex> lock(mPlaystateMutex);
+            scheduleDecodes();
+        }
+        
+        //Claims the next frames for the window and decodes up to mDecodeThreads of them at once. Frames
+        //finish out of order, the window hands them to step() in sequence.
+        void scheduleDecodes()
+        {
+            if(!mLoaderRunning)
+                return;
+            mDecodeJobs.erase(std::remove_if(mDecodeJobs.begin(), mDecodeJobs.end(), [](const JobHandle& job){ return job.isDone(); }), mDecodeJobs.end());
+            while(mWindow.size() < mReadAhead && mNumDecoding < mDecodeThreads){
+                mLoadingState = Playable::State::advance( mLoadingState, 1 );
+                auto pending = std::make_shared<PendingFrame>();
+                pending->frame = Frame(mLoadingState.currentPosition, nullptr, mSerial, mLoadingState.isFinished());
+                if(mLoadingState.isFinished()){
+                    mLoadingState.setFinished(false);
                 }
-                auto img = std::make_shared<ofImage>();
-                img->setUseTexture(false);
-                img->load(mSeqPaths[curFrame]);
-                mQueue.push({curFrame, img, serial, fin});
+                mWindow.push_back(pending);
+                ++mNumDecoding;
+                mDecodeJobs.push_back(mJobSystem.schedule([this, pending]{ decodeFrame(pending); }));
             }
         }
         
+        void decodeFrame(const std::shared_ptr<PendingFrame>& pending)
+        {
+            auto pixels = loadFrame(pending->frame.frame);
+            std::lock_guard<std::mutex> lock(mPlaystateMutex);
+            pending->frame.pixels = std::move(pixels);
+            pending->ready = true;
+            --mNumDecoding;
+            scheduleDecodes();
+        }
+        
+        //only the front of the window can be taken, later frames wait for it to finish decoding
+        bool tryPopFrame(Frame& frame)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mPlaystateMutex);
+                if(mWindow.empty() || !mWindow.front()->ready)
+                    return false;
+                frame = std::move(mWindow.front()->frame);
+                mWindow.pop_front();
+            }
+            kickLoader();
+            return true;
+        }
+        
+        //guards everything the decode jobs share with the main thread
         std::mutex mPlaystateMutex;
         uint32_t mSerial{0};
         Playable::State mLoadingState;
-        LockingQueue<Frame,3> mQueue;
+        //claimed frames in sequence order, decoded or not
+        std::deque<std::shared_ptr<PendingFrame>> mWindow;
+        std::vector<JobHandle> mDecodeJobs;
+        size_t mNumDecoding{0};
+        size_t mReadAhead{3};
+        size_t mDecodeThreads{1};
         ofTexture mCurrentImage;
         
-        std::unique_ptr<std::thread> mDataLoadingThread{nullptr};
-        bool mDataLoadingThreadRunning{false};
+        JobSystem& mJobSystem;
+        std::atomic<bool> mLoaderRunning{false};
         
-        //debug
         uint32_t mMissedFrames{0};
         
     };
@@ -449,14 +678,75 @@ namespace mediasystem {
     ImageSequence::ImageSequence(std::filesystem::path pathToImgDir, float fps, const ImageSequence::Options& options):
         mType(options.mType)
     {
-        switch(options.mType){
+        if(mType == SEQ_DISK_STREAMING && PackedFrameReader::isPackedFile(pathToImgDir))
+            mType = SEQ_PACKED;
+        auto frameCache = options.mUncached ? nullptr : options.mFrameCache ? options.mFrameCache : &DefaultFrameCache::get();
+        switch(mType){
             case SEQ_PRELOAD:
-                mImpl.reset(new PreloadImpl(std::move(pathToImgDir), fps, options.mPlayableOptions));
+                mImpl.reset(new PreloadImpl(std::move(pathToImgDir), fps, options.mPlayableOptions, frameCache, options.mJobSystem ? *options.mJobSystem : DefaultJobSystem::get(), options.mAsyncLoad, options.mMaxUploadsPerUpdate, options.mLoadProgressFn));
                 break;
             case SEQ_DISK_STREAMING:
-                mImpl.reset(new StreamingImpl(std::move(pathToImgDir), fps,  options.mPlayableOptions));
+            case SEQ_PACKED:
+                mImpl.reset(new StreamingImpl(std::move(pathToImgDir), fps,  options.mPlayableOptions, frameCache, options.mJobSystem ? *options.mJobSystem : DefaultJobSystem::get(), options.mReadAhead, options.mDecodeThreads));
+                if(mType == SEQ_PACKED && !mImpl->isPacked()){
+                    MS_LOG_WARNING("Image sequence isn't a packed frame file, streaming it as images instead");
+                }
                 break;
         }
     }
+    
+    bool ImageSequence::pack(const std::filesystem::path& imgDir, const std::filesystem::path& packedFile, PackedFrameWriter::Compression compression, JobSystem* jobs)
+    {
+        std::vector<std::filesystem::path> files;
+        ImageSequenceBase::parseSource(imgDir, files);
+        if(files.empty()){
+            MS_LOG_ERROR("No images to pack in " + imgDir.string());
+            return false;
+        }
+        
+        PackedFrameWriter writer;
+        if(!writer.open(packedFile, compression))
+            return false;
+        
+        //a partial file would play as a shorter sequence, better to have none
+        auto abandon = [&]{
+            writer.close();
+            std::error_code error;
+            std::filesystem::remove(packedFile, error);
+            return false;
+        };
+        
+        //decoded a batch at a time so only a few frames are held at once, written in order
+        auto& jobSystem = jobs ? *jobs : DefaultJobSystem::get();
+        auto batchSize = (jobSystem.getNumWorkers() + 1) * 2;
+        std::vector<ofPixels> batch(batchSize);
+        std::vector<char> decoded(batchSize);
+        for(size_t first = 0; first < files.size(); first += batchSize){
+            auto count = std::min(batchSize, files.size() - first);
+            jobSystem.parallelFor(count, [&](size_t begin, size_t end){
+                for(auto i = begin; i < end; i++){
+                    decoded[i] = ofLoadImage(batch[i], files[first + i]);
+                }
+            });
+            for(size_t i = 0; i < count; i++){
+                if(!decoded[i]){
+                    MS_LOG_ERROR("Could not load image sequence frame: " + files[first + i].string());
+                    return abandon();
+                }
+                if(!writer.add(batch[i]))
+                    return abandon();
+            }
+        }
+        
+        auto numFrames = writer.getNumFrames();
+        auto numCompressed = writer.getNumCompressedFrames();
+        auto rawBytes = writer.getRawBytes();
+        auto storedBytes = writer.getStoredBytes();
+        if(!writer.close())
+            return abandon();
+        ofLogNotice("ImageSequence") << "Packed " << numFrames << " frames into " << packedFile.string() << ", " << numCompressed << " compressed, "
+            << storedBytes / (1024 * 1024) << "MB of " << rawBytes / (1024 * 1024) << "MB raw";
+        return true;
+    }
 
 }//end namespace mediasystem
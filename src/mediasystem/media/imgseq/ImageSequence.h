@@ -2,13 +2,18 @@
 
 #include "ofMain.h"
 #include "mediasystem/util/Playable.hpp"
+#include "mediasystem/util/JobSystem.h"
+#include "mediasystem/media/imgseq/FrameCache.h"
+#include "mediasystem/media/imgseq/PackedFrames.h"
 
 namespace mediasystem {
     
     class ImageSequenceBase : public Playable<uint32_t> {
     public:
         
-        ImageSequenceBase(std::filesystem::path&& pathToImgDir, float fps, const Playable<uint32_t>::Options& options);
+        using LoadProgressFn = std::function<void(size_t numLoaded, size_t numFrames)>;
+        
+        ImageSequenceBase(std::filesystem::path&& pathToImgDir, float fps, const Playable<uint32_t>::Options& options, FrameCache* frameCache = nullptr);
         virtual ~ImageSequenceBase() = default;
         
         virtual void load() = 0;
@@ -17,6 +22,13 @@ namespace mediasystem {
         virtual glm::vec2 getSize() const  = 0;
         
         bool isLoaded() const { return mIsInit; }
+        //frames come from a file written by ImageSequence::pack instead of a directory of images
+        bool isPacked() const { return mPackedFrames != nullptr; }
+        //frames in the packed file or image files in the directory
+        size_t getNumSourceFrames() const { return mPackedFrames ? mPackedFrames->getNumFrames() : mSeqPaths.size(); }
+        virtual float getLoadProgress() const { return mIsInit ? 1.f : 0.f; }
+        //frames streaming playback had to skip because they weren't decoded in time
+        virtual uint32_t getNumMissedFrames() const { return 0; }
         
         inline void setTextureLocation(int bindLocation){ mTextureLocation = bindLocation; }
         void bind();
@@ -25,10 +37,15 @@ namespace mediasystem {
         inline void setFramerate(float fps){ mFramerate = fps; }
         inline float getFramerate() const { return mFramerate; }
         
-    protected:
-                
+        //a directory of images in name order, or a packed frame file as the only entry
         static void parseSource(const std::filesystem::path& path, std::vector<std::filesystem::path>& imageFiles, const std::vector<std::filesystem::path> allowedExt = { ".png", ".jpg", ".gif", ".JPG", ".PNG", ".jpeg", ".JPEG" });
         
+    protected:
+        
+        //decodes through the frame cache when there is one, nullptr if decoding failed
+        FrameCache::PixelsRef loadFrame(uint32_t index);
+        FrameCache::PixelsRef loadPackedFrame(uint32_t index);
+        
         std::filesystem::path mImagesDir;
         std::vector<std::filesystem::path> mSeqPaths;
         bool mIsInit{false};
@@ -36,12 +53,16 @@ namespace mediasystem {
         float mFramerate{60.f};
         float mInvFps{1.f/60.f};
         float mElapsedFrameTime{0.f};
+        FrameCache* mFrameCache{nullptr};
+        //canonical source directory, so "seq", "./seq/" and the absolute path share cache entries
+        std::string mCacheKeyPath;
+        std::shared_ptr<PackedFrameReader> mPackedFrames;
     };
     
     class ImageSequence {
     public:
         
-        enum Type { SEQ_PRELOAD, SEQ_DISK_STREAMING };
+        enum Type { SEQ_PRELOAD, SEQ_DISK_STREAMING, SEQ_PACKED };
         
         class Options {
         public:
@@ -50,24 +71,57 @@ namespace mediasystem {
             
             inline Options& streaming(){ mType = SEQ_DISK_STREAMING; return *this; }
             inline Options& preload(){ mType = SEQ_PRELOAD; return *this; }
+            //streams a file written by ImageSequence::pack, fetching a frame is a copy or an LZ4 decompress instead of a decode.
+            //streaming() picks this on its own when given a packed file.
+            inline Options& packed(){ mType = SEQ_PACKED; return *this; }
             inline Options& loop(){ mPlayableOptions.loop(); return *this; }
             inline Options& keyFrame(uint32_t frame, const Playable<uint32_t>::KeyFrameCallback& callback){ mPlayableOptions.keyFrame(frame,callback); return *this; }
             inline Options& palindrome(){ mPlayableOptions.palindrome(); return *this; }
             inline Options& reverse(){ mPlayableOptions.reverse(); return *this; }
             inline Options& loopPoints(uint32_t beginFrame, uint32_t endFrame){ mPlayableOptions.loopPoints(beginFrame,endFrame); return *this; }
+            //frames are decoded on jobs, defaults to the DefaultJobSystem that SceneManager shares with its scenes
+            inline Options& jobSystem(JobSystem& jobs){ mJobSystem = &jobs; return *this; }
+            //preload returns from load() right away and uploads up to maxUploadsPerUpdate decoded frames per update() instead
+            inline Options& asyncLoad(size_t maxUploadsPerUpdate = 4){ mAsyncLoad = true; mMaxUploadsPerUpdate = std::max<size_t>(maxUploadsPerUpdate, 1); return *this; }
+            //streaming decodes up to frames ahead of playback, at most threads of them at once. Frames can
+            //finish decoding out of order but are always shown in sequence.
+            inline Options& readAhead(size_t frames){ mReadAhead = std::max<size_t>(frames, 1); return *this; }
+            inline Options& decodeThreads(size_t threads){ mDecodeThreads = std::max<size_t>(threads, 1); return *this; }
+            //decoded frames are shared through the DefaultFrameCache unless another cache is given or caching is turned off
+            inline Options& frameCache(FrameCache& cache){ mFrameCache = &cache; mUncached = false; return *this; }
+            inline Options& uncached(){ mUncached = true; return *this; }
+            //preload calls it on the thread uploading the frames, once per frame
+            inline Options& onLoadProgress(ImageSequenceBase::LoadProgressFn fn){ mLoadProgressFn = std::move(fn); return *this; }
             
         private:
             ImageSequence::Type mType;
             Playable<uint32_t>::Options mPlayableOptions;
+            JobSystem* mJobSystem{nullptr};
+            bool mAsyncLoad{false};
+            size_t mMaxUploadsPerUpdate{4};
+            ImageSequenceBase::LoadProgressFn mLoadProgressFn;
+            size_t mReadAhead{3};
+            size_t mDecodeThreads{1};
+            FrameCache* mFrameCache{nullptr};
+            bool mUncached{false};
             friend ImageSequence;
         };
         
         ImageSequence(std::filesystem::path pathToImgDir, float fps, const ImageSequence::Options& options = ImageSequence::Options());
         
+        //Offline converter, decodes every image in imgDir on jobs and writes them in order to packedFile,
+        //which should use the packed_frames::EXTENSION so parseSource recognizes it.
+        static bool pack(const std::filesystem::path& imgDir, const std::filesystem::path& packedFile, PackedFrameWriter::Compression compression = PackedFrameWriter::COMPRESSION_LZ4, JobSystem* jobs = nullptr);
+        
+        inline Type getType() const { return mType; }
+        
         inline void load(){ return mImpl->load(); };
         inline ofTexture* getCurrentTexture(){ return mImpl->getCurrentTexture(); }
         inline glm::vec2 getSize() const { return mImpl->getSize(); }
         inline bool isLoaded() const { return mImpl->isLoaded(); }
+        inline bool isPacked() const { return mImpl->isPacked(); }
+        inline float getLoadProgress() const { return mImpl->getLoadProgress(); }
+        inline uint32_t getNumMissedFrames() const { return mImpl->getNumMissedFrames(); }
         inline void setTextureLocation(int bindLocation){ mImpl->setTextureLocation(bindLocation); }
         inline void bind(){ mImpl->bind(); }
         inline void unbind(){ mImpl->unbind(); }
@@ -77,7 +131,8 @@ namespace mediasystem {
         inline void update(double amount){ mImpl->update(amount); }
         inline void reset(){ mImpl->reset(); }
         
-        inline void setKeyFrame(uint32_t frame, const Playable<uint32_t>::KeyFrameCallback& callback){ mImpl->setKeyFrame(frame, callback); }
+        inline Playable<uint32_t>::KeyFrameId setKeyFrame(uint32_t frame, const Playable<uint32_t>::KeyFrameCallback& callback){ return mImpl->setKeyFrame(frame, callback); }
+        inline bool removeKeyFrame(Playable<uint32_t>::KeyFrameId id){ return mImpl->removeKeyFrame(id); }
         
         inline const Playable<uint32_t>::State& getState()const{ return mImpl->getState(); }
         
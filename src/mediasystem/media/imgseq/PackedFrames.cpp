@@ -0,0 +1,509 @@
+//
+//  PackedFrames.cpp
+//  ofxMediaSystem
+//
+
+#include "PackedFrames.h"
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace mediasystem {
+
+    namespace packed_frames {
+
+        namespace {
+            const size_t MIN_MATCH = 4;
+            //the format ends every block with at least this many literals
+            const size_t LAST_LITERALS = 5;
+            //and no match may start closer than this to the end
+            const size_t MF_LIMIT = 12;
+            const size_t MAX_DISTANCE = 65535;
+            const int HASH_LOG = 16;
+            //misses in a row before the search starts skipping ahead, keeps incompressible pixels cheap
+            const int SKIP_TRIGGER = 6;
+
+            inline uint32_t read32(const uint8_t* p){
+                uint32_t value;
+                std::memcpy(&value, p, sizeof(value));
+                return value;
+            }
+
+            inline uint32_t hash(uint32_t sequence){
+                return (sequence * 2654435761u) >> (32 - HASH_LOG);
+            }
+
+            //lengths of 15 and up continue in bytes of 255 and a remainder
+            inline uint8_t* writeLength(uint8_t* op, size_t length){
+                while(length >= 255){
+                    *op++ = 255;
+                    length -= 255;
+                }
+                *op++ = static_cast<uint8_t>(length);
+                return op;
+            }
+
+            inline bool readLength(const uint8_t*& ip, const uint8_t* end, size_t& length, size_t limit){
+                uint8_t byte;
+                do{
+                    if(ip == end)
+                        return false;
+                    byte = *ip++;
+                    length += byte;
+                    if(length > limit)
+                        return false;
+                }while(byte == 255);
+                return true;
+            }
+
+            inline size_t sequenceBound(size_t literals, size_t matchLength){
+                return 1 + literals / 255 + 1 + literals + 2 + matchLength / 255 + 1;
+            }
+        }
+
+        size_t compressBound(size_t srcSize)
+        {
+            return srcSize + srcSize / 255 + 16;
+        }
+
+        size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+        {
+            auto op = dst;
+            auto opEnd = dst + dstCapacity;
+            size_t anchor = 0;
+
+            if(srcSize > MF_LIMIT && srcSize <= std::numeric_limits<uint32_t>::max()){
+                std::vector<uint32_t> table(size_t(1) << HASH_LOG, 0);
+                auto matchLimit = srcSize - LAST_LITERALS;
+                auto inputLimit = srcSize - MF_LIMIT;
+                size_t searches = size_t(1) << SKIP_TRIGGER;
+                size_t ip = 0;
+                while(ip < inputLimit){
+                    auto sequence = read32(src + ip);
+                    auto& slot = table[hash(sequence)];
+                    size_t ref = slot;
+                    slot = static_cast<uint32_t>(ip);
+                    if(ref >= ip || ip - ref > MAX_DISTANCE || read32(src + ref) != sequence){
+                        ip += searches++ >> SKIP_TRIGGER;
+                        continue;
+                    }
+                    searches = size_t(1) << SKIP_TRIGGER;
+
+                    while(ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]){
+                        --ip;
+                        --ref;
+                    }
+                    auto length = MIN_MATCH;
+                    while(ip + length < matchLimit && src[ip + length] == src[ref + length]){
+                        ++length;
+                    }
+
+                    auto literals = ip - anchor;
+                    if(static_cast<size_t>(opEnd - op) < sequenceBound(literals, length))
+                        return 0;
+                    auto token = op++;
+                    if(literals >= 15){
+                        *token = 15 << 4;
+                        op = writeLength(op, literals - 15);
+                    }else{
+                        *token = static_cast<uint8_t>(literals << 4);
+                    }
+                    std::memcpy(op, src + anchor, literals);
+                    op += literals;
+                    auto offset = ip - ref;
+                    *op++ = static_cast<uint8_t>(offset & 0xff);
+                    *op++ = static_cast<uint8_t>(offset >> 8);
+                    auto matchCode = length - MIN_MATCH;
+                    if(matchCode >= 15){
+                        *token |= 15;
+                        op = writeLength(op, matchCode - 15);
+                    }else{
+                        *token |= static_cast<uint8_t>(matchCode);
+                    }
+
+                    ip += length;
+                    anchor = ip;
+                    //the end of a match is a likely start for the next one
+                    if(ip < inputLimit)
+                        table[hash(read32(src + ip - 2))] = static_cast<uint32_t>(ip - 2);
+                }
+            }
+
+            auto literals = srcSize - anchor;
+            if(static_cast<size_t>(opEnd - op) < sequenceBound(literals, 0))
+                return 0;
+            if(literals >= 15){
+                *op++ = 15 << 4;
+                op = writeLength(op, literals - 15);
+            }else{
+                *op++ = static_cast<uint8_t>(literals << 4);
+            }
+            if(literals)
+                std::memcpy(op, src + anchor, literals);
+            op += literals;
+            return op - dst;
+        }
+
+        bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+        {
+            auto ip = src;
+            auto ipEnd = src + srcSize;
+            auto op = dst;
+            auto opEnd = dst + dstSize;
+            while(ip < ipEnd){
+                auto token = *ip++;
+
+                size_t literals = token >> 4;
+                if(literals == 15 && !readLength(ip, ipEnd, literals, dstSize))
+                    return false;
+                if(static_cast<size_t>(ipEnd - ip) < literals || static_cast<size_t>(opEnd - op) < literals)
+                    return false;
+                if(literals)
+                    std::memcpy(op, ip, literals);
+                ip += literals;
+                op += literals;
+                //the last sequence is literals only
+                if(ip == ipEnd)
+                    break;
+
+                if(ipEnd - ip < 2)
+                    return false;
+                size_t offset = ip[0] | (ip[1] << 8);
+                ip += 2;
+                if(offset == 0 || offset > static_cast<size_t>(op - dst))
+                    return false;
+                size_t length = token & 15;
+                if(length == 15 && !readLength(ip, ipEnd, length, dstSize))
+                    return false;
+                length += MIN_MATCH;
+                if(static_cast<size_t>(opEnd - op) < length)
+                    return false;
+
+                if(offset >= length){
+                    std::memcpy(op, op - offset, length);
+                }else{
+                    //overlapping, the match repeats every offset bytes. Each copy only reads what is
+                    //already written and is twice the size of the last, long runs stay a few memcpys.
+                    size_t copied = 0;
+                    size_t step = offset;
+                    while(copied < length){
+                        auto chunk = std::min(step, length - copied);
+                        std::memcpy(op + copied, op + copied - step, chunk);
+                        copied += chunk;
+                        step *= 2;
+                    }
+                }
+                op += length;
+            }
+            return op == opEnd;
+        }
+
+    }//end namespace packed_frames
+
+    /////PackedFrameWriter
+
+    PackedFrameWriter::~PackedFrameWriter()
+    {
+        if(isOpen())
+            close();
+    }
+
+    bool PackedFrameWriter::open(const std::filesystem::path& file, Compression compression, float minRatio)
+    {
+        if(isOpen())
+            close();
+        mFile = file;
+        mCompression = compression;
+        mMinRatio = minRatio;
+        mHeader = packed_frames::Header();
+        std::memcpy(mHeader.magic, packed_frames::MAGIC, sizeof(mHeader.magic));
+        mHeader.version = packed_frames::VERSION;
+        mIndex.clear();
+        mStoredBytes = 0;
+        mNumCompressed = 0;
+
+        mStream.open(file, std::ios::binary | std::ios::trunc);
+        if(!mStream.is_open()){
+            ofLogError("PackedFrames") << "Could not open " << file.string() << " for writing";
+            return false;
+        }
+        //rewritten by close() once the frame count and index are known
+        mStream.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+        mOffset = sizeof(mHeader);
+        return mStream.good();
+    }
+
+    bool PackedFrameWriter::add(const ofPixels& pixels)
+    {
+        if(!isOpen())
+            return false;
+        if(!pixels.isAllocated()){
+            ofLogError("PackedFrames") << "Frame " << mIndex.size() << " of " << mFile.string() << " has no pixels";
+            return false;
+        }
+        if(mIndex.empty()){
+            mHeader.width = static_cast<uint32_t>(pixels.getWidth());
+            mHeader.height = static_cast<uint32_t>(pixels.getHeight());
+            mHeader.channels = static_cast<uint32_t>(pixels.getNumChannels());
+            mHeader.frameBytes = static_cast<uint64_t>(mHeader.width) * mHeader.height * mHeader.channels;
+            if(mHeader.frameBytes > std::numeric_limits<uint32_t>::max()){
+                ofLogError("PackedFrames") << "Frames of " << mFile.string() << " are too large to pack";
+                return false;
+            }
+        }else if(pixels.getWidth() != mHeader.width || pixels.getHeight() != mHeader.height || pixels.getNumChannels() != mHeader.channels){
+            ofLogError("PackedFrames") << "Frame " << mIndex.size() << " of " << mFile.string() << " is " << pixels.getWidth() << "x" << pixels.getHeight() << "x" << pixels.getNumChannels()
+                << ", expected " << mHeader.width << "x" << mHeader.height << "x" << mHeader.channels;
+            return false;
+        }
+
+        static const char PADDING[packed_frames::FRAME_ALIGNMENT] = {};
+        auto padding = (packed_frames::FRAME_ALIGNMENT - mOffset % packed_frames::FRAME_ALIGNMENT) % packed_frames::FRAME_ALIGNMENT;
+        mStream.write(PADDING, padding);
+        mOffset += padding;
+
+        packed_frames::IndexEntry entry{mOffset, static_cast<uint32_t>(mHeader.frameBytes), packed_frames::CODEC_RAW};
+        auto data = pixels.getData();
+        if(mCompression == COMPRESSION_LZ4){
+            mBuffer.resize(packed_frames::compressBound(mHeader.frameBytes));
+            auto limit = std::min(static_cast<size_t>(mHeader.frameBytes * mMinRatio), mBuffer.size());
+            if(auto size = packed_frames::compress(data, mHeader.frameBytes, mBuffer.data(), limit)){
+                entry.size = static_cast<uint32_t>(size);
+                entry.codec = packed_frames::CODEC_LZ4;
+                data = mBuffer.data();
+                ++mNumCompressed;
+            }
+        }
+        mStream.write(reinterpret_cast<const char*>(data), entry.size);
+        mOffset += entry.size;
+        mStoredBytes += entry.size;
+        mIndex.push_back(entry);
+
+        if(!mStream.good()){
+            ofLogError("PackedFrames") << "Failed writing frame " << mIndex.size() - 1 << " to " << mFile.string();
+            return false;
+        }
+        return true;
+    }
+
+    bool PackedFrameWriter::close()
+    {
+        if(!isOpen())
+            return false;
+        static const char PADDING[alignof(packed_frames::IndexEntry)] = {};
+        auto padding = (alignof(packed_frames::IndexEntry) - mOffset % alignof(packed_frames::IndexEntry)) % alignof(packed_frames::IndexEntry);
+        mStream.write(PADDING, padding);
+        mOffset += padding;
+
+        mHeader.numFrames = static_cast<uint32_t>(mIndex.size());
+        mHeader.indexOffset = mOffset;
+        mStream.write(reinterpret_cast<const char*>(mIndex.data()), mIndex.size() * sizeof(packed_frames::IndexEntry));
+        mStream.seekp(0);
+        mStream.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+
+        auto ok = mStream.good();
+        mStream.close();
+        if(!ok){
+            ofLogError("PackedFrames") << "Failed writing the index of " << mFile.string();
+        }
+        return ok;
+    }
+
+    /////PackedFrameReader
+
+    bool PackedFrameReader::isPackedFile(const std::filesystem::path& file)
+    {
+        if(file.extension() != packed_frames::EXTENSION)
+            return false;
+        std::ifstream stream(file, std::ios::binary);
+        char magic[sizeof(packed_frames::MAGIC)];
+        if(!stream.read(magic, sizeof(magic)))
+            return false;
+        return std::memcmp(magic, packed_frames::MAGIC, sizeof(magic)) == 0;
+    }
+
+    PackedFrameReader::~PackedFrameReader()
+    {
+        close();
+    }
+
+    bool PackedFrameReader::open(const std::filesystem::path& file)
+    {
+        close();
+        mFile = file;
+
+        //mapped copy on write so raw frames can be handed out as writable ofPixels
+#if defined(_WIN32)
+        auto fileHandle = CreateFileW(file.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(fileHandle == INVALID_HANDLE_VALUE){
+            ofLogError("PackedFrames") << "Could not open " << file.string();
+            return false;
+        }
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0){
+            CloseHandle(fileHandle);
+            ofLogError("PackedFrames") << "Could not read the size of " << file.string();
+            return false;
+        }
+        auto mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        auto mapping = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+        if(!mapping){
+            if(mappingHandle)
+                CloseHandle(mappingHandle);
+            CloseHandle(fileHandle);
+            ofLogError("PackedFrames") << "Could not map " << file.string();
+            return false;
+        }
+        mFileHandle = fileHandle;
+        mMappingHandle = mappingHandle;
+        mData = static_cast<uint8_t*>(mapping);
+        mSize = static_cast<size_t>(size.QuadPart);
+#else
+        auto fd = ::open(file.c_str(), O_RDONLY);
+        if(fd < 0){
+            ofLogError("PackedFrames") << "Could not open " << file.string();
+            return false;
+        }
+        struct stat info;
+        if(fstat(fd, &info) != 0 || info.st_size == 0){
+            ::close(fd);
+            ofLogError("PackedFrames") << "Could not read the size of " << file.string();
+            return false;
+        }
+        auto mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        //the mapping holds its own reference to the file
+        ::close(fd);
+        if(mapping == MAP_FAILED){
+            ofLogError("PackedFrames") << "Could not map " << file.string();
+            return false;
+        }
+        mData = static_cast<uint8_t*>(mapping);
+        mSize = static_cast<size_t>(info.st_size);
+#endif
+
+        if(mSize < sizeof(mHeader)){
+            ofLogError("PackedFrames") << file.string() << " is too small to be a packed frame file";
+            close();
+            return false;
+        }
+        std::memcpy(&mHeader, mData, sizeof(mHeader));
+        const char* error = nullptr;
+        if(std::memcmp(mHeader.magic, packed_frames::MAGIC, sizeof(mHeader.magic)) != 0){
+            error = "bad magic";
+        }else if(mHeader.version != packed_frames::VERSION){
+            error = "unsupported version";
+        }else if(mHeader.channels < 1 || mHeader.channels > 4 || mHeader.frameBytes != static_cast<uint64_t>(mHeader.width) * mHeader.height * mHeader.channels){
+            error = "bad frame size";
+        }else if(mHeader.indexOffset % alignof(packed_frames::IndexEntry) != 0 || mHeader.indexOffset > mSize
+                 || (mSize - mHeader.indexOffset) / sizeof(packed_frames::IndexEntry) < mHeader.numFrames){
+            error = "truncated index";
+        }else{
+            auto index = reinterpret_cast<const packed_frames::IndexEntry*>(mData + mHeader.indexOffset);
+            for(uint32_t i = 0; i < mHeader.numFrames && !error; i++){
+                auto& entry = index[i];
+                if(entry.offset > mSize || entry.size > mSize - entry.offset)
+                    error = "frame out of bounds";
+                else if(entry.codec == packed_frames::CODEC_RAW && entry.size != mHeader.frameBytes)
+                    error = "bad raw frame size";
+                else if(entry.codec != packed_frames::CODEC_RAW && entry.codec != packed_frames::CODEC_LZ4)
+                    error = "unknown codec";
+            }
+            if(!error)
+                mIndex = index;
+        }
+        if(error){
+            ofLogError("PackedFrames") << file.string() << " is not a valid packed frame file: " << error;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void PackedFrameReader::close()
+    {
+        if(mData){
+#if defined(_WIN32)
+            UnmapViewOfFile(mData);
+            CloseHandle(mMappingHandle);
+            CloseHandle(mFileHandle);
+            mMappingHandle = nullptr;
+            mFileHandle = nullptr;
+#else
+            munmap(mData, mSize);
+#endif
+        }
+        mData = nullptr;
+        mSize = 0;
+        mIndex = nullptr;
+        mHeader = packed_frames::Header();
+    }
+
+    packed_frames::Codec PackedFrameReader::getCodec(size_t index) const
+    {
+        if(index >= getNumFrames())
+            return packed_frames::CODEC_RAW;
+        return static_cast<packed_frames::Codec>(mIndex[index].codec);
+    }
+
+    uint8_t* PackedFrameReader::getFrameData(size_t index) const
+    {
+        if(index >= getNumFrames() || mIndex[index].codec != packed_frames::CODEC_RAW)
+            return nullptr;
+        return mData + mIndex[index].offset;
+    }
+
+    void PackedFrameReader::prefetch(size_t index) const
+    {
+        if(index >= getNumFrames())
+            return;
+        auto& entry = mIndex[index];
+        auto begin = mData + entry.offset;
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+        //one readahead request for the whole frame instead of a fault per page
+        auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        auto first = reinterpret_cast<uintptr_t>(begin) & ~(page - 1);
+        madvise(reinterpret_cast<void*>(first), reinterpret_cast<uintptr_t>(begin) + entry.size - first, MADV_WILLNEED);
+#endif
+        static const size_t MIN_PAGE_SIZE = 4096;
+        uint8_t touched = 0;
+        for(size_t offset = 0; offset < entry.size; offset += MIN_PAGE_SIZE){
+            touched ^= reinterpret_cast<const volatile uint8_t*>(begin)[offset];
+        }
+        (void)touched;
+    }
+
+    bool PackedFrameReader::readFrame(size_t index, uint8_t* dst) const
+    {
+        if(index >= getNumFrames())
+            return false;
+        auto& entry = mIndex[index];
+        auto src = mData + entry.offset;
+        if(entry.codec == packed_frames::CODEC_RAW){
+            std::memcpy(dst, src, entry.size);
+            return true;
+        }
+        if(!packed_frames::decompress(src, entry.size, dst, mHeader.frameBytes)){
+            ofLogError("PackedFrames") << "Frame " << index << " of " << mFile.string() << " is corrupt";
+            return false;
+        }
+        return true;
+    }
+
+    bool PackedFrameReader::readFrame(size_t index, ofPixels& pixels) const
+    {
+        if(index >= getNumFrames())
+            return false;
+        if(!pixels.isAllocated() || pixels.getWidth() != mHeader.width || pixels.getHeight() != mHeader.height || pixels.getNumChannels() != mHeader.channels)
+            pixels.allocate(mHeader.width, mHeader.height, mHeader.channels);
+        return readFrame(index, pixels.getData());
+    }
+
+}//end namespace mediasystem
@@ -0,0 +1,152 @@
+//
+//  PackedFrames.h
+//  ofxMediaSystem
+//
+//  Image sequences pre-decoded into a single file so playback never decodes a PNG or JPEG.
+//  A 64 byte "MSPF" header, the frames, then an index of where each frame starts and how it is
+//  stored. Frames are kept raw, or LZ4 block compressed when that saves enough to be worth the
+//  decompress. The reader memory maps the file, fetching a raw frame is a pointer into the mapping.
+//  Everything is stored in native byte order, every platform openFrameworks targets is little endian.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include "ofMain.h"
+
+namespace mediasystem {
+
+    namespace packed_frames {
+        static const char MAGIC[4] = {'M','S','P','F'};
+        static const uint32_t VERSION = 1;
+        static const char* const EXTENSION = ".msframes";
+        //frame data starts on this boundary in the file and so in the mapping
+        static const uint64_t FRAME_ALIGNMENT = 64;
+
+        enum Codec : uint32_t {
+            CODEC_RAW = 0,
+            CODEC_LZ4 = 1
+        };
+
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            uint32_t width;
+            uint32_t height;
+            uint32_t channels;
+            uint32_t numFrames;
+            uint64_t frameBytes;    //width * height * channels
+            uint64_t indexOffset;   //numFrames IndexEntry records
+            uint8_t reserved[24];
+        };
+        static_assert(sizeof(Header) == 64, "packed frame header must stay 64 bytes");
+
+        struct IndexEntry {
+            uint64_t offset;
+            uint32_t size;          //stored bytes, frameBytes for raw frames
+            uint32_t codec;
+        };
+        static_assert(sizeof(IndexEntry) == 16, "packed frame index entries must stay 16 bytes");
+
+        //LZ4 block format, no frame header or checksums. compress returns 0 if the output doesn't fit
+        //in dstCapacity, decompress fails unless it produces exactly dstSize bytes.
+        size_t compressBound(size_t srcSize);
+        size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+        bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+    }
+
+    //Writes frames one at a time, the index and header are written by close(). Every frame must
+    //have the size and channels of the first.
+    class PackedFrameWriter {
+    public:
+
+        enum Compression {
+            COMPRESSION_NONE,
+            COMPRESSION_LZ4
+        };
+
+        PackedFrameWriter() = default;
+        ~PackedFrameWriter();
+
+        //non copyable
+        PackedFrameWriter(const PackedFrameWriter&) = delete;
+        PackedFrameWriter& operator=(const PackedFrameWriter&) = delete;
+
+        //compressed frames that keep more than minRatio of the raw size are stored raw instead
+        bool open(const std::filesystem::path& file, Compression compression = COMPRESSION_LZ4, float minRatio = .9f);
+        bool add(const ofPixels& pixels);
+        bool close();
+
+        bool isOpen() const { return mStream.is_open(); }
+        size_t getNumFrames() const { return mIndex.size(); }
+        size_t getNumCompressedFrames() const { return mNumCompressed; }
+        uint64_t getRawBytes() const { return mHeader.frameBytes * mIndex.size(); }
+        uint64_t getStoredBytes() const { return mStoredBytes; }
+
+    private:
+
+        std::filesystem::path mFile;
+        std::ofstream mStream;
+        Compression mCompression{COMPRESSION_LZ4};
+        float mMinRatio{.9f};
+        packed_frames::Header mHeader{};
+        std::vector<packed_frames::IndexEntry> mIndex;
+        std::vector<uint8_t> mBuffer;
+        uint64_t mOffset{0};
+        uint64_t mStoredBytes{0};
+        size_t mNumCompressed{0};
+    };
+
+    //Read only view of a packed file. Safe to fetch frames from several threads at once.
+    class PackedFrameReader {
+    public:
+
+        //checks the extension and the magic
+        static bool isPackedFile(const std::filesystem::path& file);
+
+        PackedFrameReader() = default;
+        ~PackedFrameReader();
+
+        //non copyable
+        PackedFrameReader(const PackedFrameReader&) = delete;
+        PackedFrameReader& operator=(const PackedFrameReader&) = delete;
+
+        bool open(const std::filesystem::path& file);
+        void close();
+
+        bool isOpen() const { return mData != nullptr; }
+        const std::filesystem::path& getFile() const { return mFile; }
+        size_t getNumFrames() const { return mIndex ? mHeader.numFrames : 0; }
+        size_t getWidth() const { return mHeader.width; }
+        size_t getHeight() const { return mHeader.height; }
+        size_t getNumChannels() const { return mHeader.channels; }
+        size_t getFrameBytes() const { return mHeader.frameBytes; }
+        packed_frames::Codec getCodec(size_t index) const;
+
+        //Raw frames only, a pointer into the mapping or nullptr for compressed frames. The mapping is
+        //copy on write, writing through it never reaches the file or other readers.
+        uint8_t* getFrameData(size_t index) const;
+        //faults the pages of a frame in so the first touch somewhere else doesn't wait on the disk
+        void prefetch(size_t index) const;
+        //copies or decompresses a frame, dst must hold getFrameBytes()
+        bool readFrame(size_t index, uint8_t* dst) const;
+        bool readFrame(size_t index, ofPixels& pixels) const;
+
+    private:
+
+        std::filesystem::path mFile;
+        packed_frames::Header mHeader{};
+        const packed_frames::IndexEntry* mIndex{nullptr};
+        uint8_t* mData{nullptr};
+        size_t mSize{0};
+#if defined(_WIN32)
+        void* mFileHandle{nullptr};
+        void* mMappingHandle{nullptr};
+#endif
+    };
+
+}//end namespace mediasystem
@@ -11,46 +11,176 @@
 #include "Storage.hpp"
 #include "AllocationMiddleware.hpp"
 #include "AllocationPolicy.hpp"
+#include "AllocationReport.hpp"
+#include <shared_mutex>
 
 namespace mediasystem {
     
     class AllocationManager {
     public:
         
+        //the policy map is guarded so allocators can look up policies from worker threads,
+        //the policies themselves are only thread-safe with THREAD_CACHED_POOL
         template<typename T>
         IAllocationPolicy* getPolicy(){
-            IAllocationPolicy* ret = nullptr;
+            std::shared_lock<std::shared_mutex> lock(*mMutex);
             auto found = mAllocaitonPolicies.find(type_id<T>);
             if( found != mAllocaitonPolicies.end()){
                 return found->second.get();
             }
-            return ret;
+            return nullptr;
         }
         
+        //a replaced policy is retired rather than destroyed and lives as long as the manager
         template<typename T>
         IAllocationPolicy* setPolicy(const AllocationPolicyFormat& fmt = AllocationPolicyFormat()){
             auto policy = createAllocationPolicy<T>(fmt);
-            auto ret = policy.get();
-            auto found = mAllocaitonPolicies.find(type_id<T>);
-            if( found != mAllocaitonPolicies.end()){
-                found->second = std::move(policy);
-            }else{
-                mAllocaitonPolicies.emplace(type_id<T>, std::move(policy));
+            std::unique_lock<std::shared_mutex> lock(*mMutex);
+            return setPolicyLocked<T>(std::move(policy));
+        }
+        
+        //returns T's policy if it is a Policy, otherwise creates one from the format. Throws if T
+        //already has a policy of another type since allocators may be holding on to it.
+        template<typename T, typename Policy>
+        Policy* trySetStaticPolicy(const AllocationPolicyFormat& fmt = AllocationPolicyFormat()){
+            {
+                std::shared_lock<std::shared_mutex> lock(*mMutex);
+                if(auto existing = findStaticPolicy<T, Policy>()){
+                    return existing;
+                }
             }
+            auto policy = std::unique_ptr<Policy>(new Policy(sizeof(T), fmt));
+            std::unique_lock<std::shared_mutex> lock(*mMutex);
+            if(auto existing = findStaticPolicy<T, Policy>()){
+                return existing;
+            }
+            auto ret = policy.get();
+            setPolicyLocked<T>(std::move(policy));
             return ret;
         }
         
         template<typename T>
         IAllocationPolicy* trySetPolicy(const AllocationPolicyFormat& fmt = AllocationPolicyFormat()){
+            {
+                std::shared_lock<std::shared_mutex> lock(*mMutex);
+                auto found = mAllocaitonPolicies.find(type_id<T>);
+                if( found != mAllocaitonPolicies.end()){
+                    return found->second.get();
+                }
+            }
+            auto policy = createAllocationPolicy<T>(fmt);
+            std::unique_lock<std::shared_mutex> lock(*mMutex);
+            //another thread may have won the race while the policy was built
             auto found = mAllocaitonPolicies.find(type_id<T>);
             if( found != mAllocaitonPolicies.end()){
                 return found->second.get();
             }
-            return setPolicy<T>(fmt);
+            return setPolicyLocked<T>(std::move(policy));
+        }
+        
+        //releases everything handed out by FRAME_ARENA policies, other policies are untouched
+        void resetArenas(){
+            std::shared_lock<std::shared_mutex> lock(*mMutex);
+            for(auto & policy : mAllocaitonPolicies){
+                if(policy.second->getStrategyType() == FRAME_ARENA){
+                    policy.second->reset();
+                }
+            }
+        }
+        
+        //samples every policy that has STATS middleware, allocation rates are relative to the previous report.
+        //reservedBytes is approximate while other threads are allocating
+        AllocationReport report() const {
+            AllocationReport ret;
+            std::shared_lock<std::shared_mutex> lock(*mMutex);
+            for(auto & policy : mAllocaitonPolicies){
+                if(auto stats = static_cast<IAllocationStats*>(policy.second->getMiddleware(STATS))){
+                    AllocationReport::Entry entry;
+                    entry.stats = stats->sample();
+                    entry.strategy = policy.second->getStrategyType();
+                    entry.storage = policy.second->getStorageType();
+                    entry.reservedBytes = policy.second->getStorageSize() * policy.second->getStorageCount();
+                    ret.entries.push_back(std::move(entry));
+                }
+            }
+            return ret;
+        }
+        
+        //compacts every policy, not thread-safe with respect to allocations
+        void compact(){
+            std::shared_lock<std::shared_mutex> lock(*mMutex);
+            for(auto & policy : mAllocaitonPolicies){
+                policy.second->compact();
+            }
+        }
+        
+        //the policy whose storage holds ptr, nullptr for heap memory
+        IAllocationPolicy* findPolicy(const void* ptr) const {
+            std::shared_lock<std::shared_mutex> lock(*mMutex);
+            for(auto & policy : mAllocaitonPolicies){
+                if(policy.second->getStorageIndex(ptr) != IMemoryStorage::npos){
+                    return policy.second.get();
+                }
+            }
+            return nullptr;
+        }
+        
+        //adds a LEAK_TRACKER to every policy created from now on, set it up before the first allocator
+        void setLeakTracking(bool enabled, bool captureBacktraces = false){
+            mLeakTracking = enabled;
+            mLeakTrackingBacktraces = captureBacktraces;
+        }
+        
+        AllocationLeakReport reportLeaks() const {
+            AllocationLeakReport ret;
+#if defined(MS_ALLOW_LEAK_TRACKING)
+            std::shared_lock<std::shared_mutex> lock(*mMutex);
+            auto collect = [&ret](const std::unique_ptr<IAllocationPolicy>& policy){
+                if(auto tracker = static_cast<IAllocationLeakTracker*>(policy->getMiddleware(LEAK_TRACKER))){
+                    auto outstanding = tracker->getOutstanding();
+                    if(!outstanding.empty()){
+                        ret.entries.push_back({tracker->getTypeName(), tracker->getTypeSize(), std::move(outstanding)});
+                    }
+                }
+            };
+            for(auto & policy : mAllocaitonPolicies){
+                collect(policy.second);
+            }
+            for(auto & policy : mRetiredPolicies){
+                collect(policy);
+            }
+#endif
+            return ret;
         }
         
     private:
         
+        template<typename T, typename Policy>
+        Policy* findStaticPolicy(){
+            auto found = mAllocaitonPolicies.find(type_id<T>);
+            if( found == mAllocaitonPolicies.end()){
+                return nullptr;
+            }
+            if(auto policy = dynamic_cast<Policy*>(found->second.get())){
+                return policy;
+            }
+            throw std::runtime_error("Type already has an allocation policy that doesn't match the requested static policy.");
+        }
+        
+        template<typename T>
+        IAllocationPolicy* setPolicyLocked(std::unique_ptr<IAllocationPolicy>&& policy){
+            auto ret = policy.get();
+            auto found = mAllocaitonPolicies.find(type_id<T>);
+            if( found != mAllocaitonPolicies.end()){
+                //allocators cache their policy and outstanding memory belongs to it, so it can't die yet
+                mRetiredPolicies.push_back(std::move(found->second));
+                found->second = std::move(policy);
+            }else{
+                mAllocaitonPolicies.emplace(type_id<T>, std::move(policy));
+            }
+            return ret;
+        }
+        
         template<typename T>
         std::unique_ptr<IAllocationPolicy> createAllocationPolicy( const AllocationPolicyFormat& fmt) {
             std::unique_ptr<IAllocationPolicy> policy;
@@ -70,24 +200,119 @@ namespace mediasystem {
                             auto pool = std::unique_ptr<AllocationPolicy<UnreclaimedPool,BlockListStorage>>( new AllocationPolicy<UnreclaimedPool,BlockListStorage>(sizeof(T), fmt.requestedStorageSize, fmt.storageInitialCount));
                             policy = std::move(pool);
                         }break;
+                        case MAPPED_STORAGE:{
+                            auto pool = std::unique_ptr<AllocationPolicy<UnreclaimedPool,MappedStorage>>( new AllocationPolicy<UnreclaimedPool,MappedStorage>(sizeof(T), fmt.requestedStorageSize, fmt.mappedOptions));
+                            policy = std::move(pool);
+                        }break;
                         default:
                             throw std::runtime_error("An UNRECLAIMED_POOL allocator format MUST have a storage type.");
                             break;
                     }
                 }break;
+                case SLAB_POOL: {
+                    if(fmt.storage != BLOCK_LIST_STORAGE){
+                        throw std::runtime_error("A SLAB_POOL allocator format MUST use BLOCK_LIST_STORAGE.");
+                    }
+                    auto pool = std::unique_ptr<AllocationPolicy<SlabPool,BlockListStorage>>( new AllocationPolicy<SlabPool,BlockListStorage>(sizeof(T), fmt.requestedStorageSize, fmt.storageInitialCount));
+                    pool->getStrategy().setEmptyBlockWatermark(fmt.slabEmptyBlockWatermark);
+                    policy = std::move(pool);
+                }break;
+                case THREAD_CACHED_POOL: {
+                    switch(fmt.storage){
+                        case FIXED_SIZE_STORAGE:{
+                            auto pool = std::unique_ptr<AllocationPolicy<ThreadCachedPool,FixedSizeStorage>>( new AllocationPolicy<ThreadCachedPool,FixedSizeStorage>(sizeof(T), fmt.requestedStorageSize));
+                            pool->getStrategy().setMagazineSize(fmt.threadMagazineSize);
+                            policy = std::move(pool);
+                        }break;
+                        case BLOCK_LIST_STORAGE:{
+                            auto pool = std::unique_ptr<AllocationPolicy<ThreadCachedPool,BlockListStorage>>( new AllocationPolicy<ThreadCachedPool,BlockListStorage>(sizeof(T), fmt.requestedStorageSize, fmt.storageInitialCount));
+                            pool->getStrategy().setMagazineSize(fmt.threadMagazineSize);
+                            policy = std::move(pool);
+                        }break;
+                        case MAPPED_STORAGE:{
+                            auto pool = std::unique_ptr<AllocationPolicy<ThreadCachedPool,MappedStorage>>( new AllocationPolicy<ThreadCachedPool,MappedStorage>(sizeof(T), fmt.requestedStorageSize, fmt.mappedOptions));
+                            pool->getStrategy().setMagazineSize(fmt.threadMagazineSize);
+                            policy = std::move(pool);
+                        }break;
+                        default:
+                            throw std::runtime_error("A THREAD_CACHED_POOL allocator format MUST have a storage type.");
+                            break;
+                    }
+                    //lazy initialization on first allocate isn't thread-safe
+                    policy->initialize();
+                }break;
+                case SIZE_CLASS_POOL: {
+                    switch(fmt.storage){
+                        case FIXED_SIZE_STORAGE:{
+                            auto pool = std::unique_ptr<AllocationPolicy<SizeClassPool,FixedSizeStorage>>( new AllocationPolicy<SizeClassPool,FixedSizeStorage>(sizeof(T), fmt.requestedStorageSize));
+                            pool->getStrategy().setMaxClassObjects(fmt.sizeClassMaxObjects);
+                            policy = std::move(pool);
+                        }break;
+                        case BLOCK_LIST_STORAGE:{
+                            auto pool = std::unique_ptr<AllocationPolicy<SizeClassPool,BlockListStorage>>( new AllocationPolicy<SizeClassPool,BlockListStorage>(sizeof(T), fmt.requestedStorageSize, fmt.storageInitialCount));
+                            pool->getStrategy().setMaxClassObjects(fmt.sizeClassMaxObjects);
+                            policy = std::move(pool);
+                        }break;
+                        case MAPPED_STORAGE:{
+                            auto pool = std::unique_ptr<AllocationPolicy<SizeClassPool,MappedStorage>>( new AllocationPolicy<SizeClassPool,MappedStorage>(sizeof(T), fmt.requestedStorageSize, fmt.mappedOptions));
+                            pool->getStrategy().setMaxClassObjects(fmt.sizeClassMaxObjects);
+                            policy = std::move(pool);
+                        }break;
+                        default:
+                            throw std::runtime_error("A SIZE_CLASS_POOL allocator format MUST have a storage type.");
+                            break;
+                    }
+                }break;
+                case FRAME_ARENA: {
+                    switch(fmt.storage){
+                        case FIXED_SIZE_STORAGE:{
+                            auto arena = std::unique_ptr<AllocationPolicy<FrameArena,FixedSizeStorage>>( new AllocationPolicy<FrameArena,FixedSizeStorage>(sizeof(T), fmt.requestedStorageSize));
+                            policy = std::move(arena);
+                        }break;
+                        case BLOCK_LIST_STORAGE:{
+                            auto arena = std::unique_ptr<AllocationPolicy<FrameArena,BlockListStorage>>( new AllocationPolicy<FrameArena,BlockListStorage>(sizeof(T), fmt.requestedStorageSize, fmt.storageInitialCount));
+                            policy = std::move(arena);
+                        }break;
+                        case MAPPED_STORAGE:{
+                            auto arena = std::unique_ptr<AllocationPolicy<FrameArena,MappedStorage>>( new AllocationPolicy<FrameArena,MappedStorage>(sizeof(T), fmt.requestedStorageSize, fmt.mappedOptions));
+                            policy = std::move(arena);
+                        }break;
+                        default:
+                            throw std::runtime_error("A FRAME_ARENA allocator format MUST have a storage type.");
+                            break;
+                    }
+                }break;
             }
             for(auto & middleware : fmt.middleware){
                 switch(middleware){
                     case CONSOLE_LOGGER:{
                         policy->addMiddleware( std::unique_ptr<AllocationConsoleLogger<T>>( new AllocationConsoleLogger<T>()) );
                     }break;
+                    case STATS:{
+                        policy->addMiddleware( std::unique_ptr<AllocationStats<T>>( new AllocationStats<T>()) );
+                    }break;
+#if defined(MS_ALLOW_LEAK_TRACKING)
+                    case LEAK_TRACKER:{
+                        policy->addMiddleware( std::unique_ptr<AllocationLeakTracker<T>>( new AllocationLeakTracker<T>(fmt.leakTrackerBacktraces)) );
+                    }break;
+#endif
                     default: continue;
                 }
             }
+#if defined(MS_ALLOW_LEAK_TRACKING)
+            if(mLeakTracking && !policy->getMiddleware(LEAK_TRACKER)){
+                policy->addMiddleware( std::unique_ptr<AllocationLeakTracker<T>>( new AllocationLeakTracker<T>(mLeakTrackingBacktraces)) );
+            }
+#endif
             return policy;
         }
         
         std::map<type_id_t, std::unique_ptr<IAllocationPolicy>> mAllocaitonPolicies;
+        std::vector<std::unique_ptr<IAllocationPolicy>> mRetiredPolicies;
+        bool mLeakTracking{false};
+        bool mLeakTrackingBacktraces{false};
+        //held by pointer so the manager stays movable
+        std::unique_ptr<std::shared_mutex> mMutex{new std::shared_mutex()};
         //todo, could include initializers if they worked...
     };
     
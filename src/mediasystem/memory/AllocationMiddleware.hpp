@@ -7,20 +7,37 @@
 
 #pragma once
 #include "ofMain.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(MS_ALLOW_LEAK_TRACKING) && __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define MS_HAS_ALLOCATION_BACKTRACE
+#endif
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
 
 namespace mediasystem {
     
-    enum AllocationMiddlewareType { CONSOLE_LOGGER, NO_MIDDLEWARE };
+    enum AllocationMiddlewareType { CONSOLE_LOGGER, STATS, LEAK_TRACKER, NO_MIDDLEWARE };
     
     class IAllocaitonMiddleware {
     public:
+        virtual ~IAllocaitonMiddleware() = default;
         virtual void onAllocation(void* allocatedPtr, size_t count) = 0;
         virtual void onDeallocation(void* deallocatedPtr, size_t count) = 0;
         virtual AllocationMiddlewareType getType() const = 0;
     };
 
     template< typename T >
-    class AllocationConsoleLogger : public IAllocaitonMiddleware {
+    class AllocationConsoleLogger final : public IAllocaitonMiddleware {
     public:
         void onAllocation(void* allocatedPtr, size_t count) override
         {
@@ -51,5 +68,210 @@ namespace mediasystem {
         size_t mCurrentAllocationsCount{0};
         size_t mDeallocationsCount{0};
     };
+    
+    struct AllocationStatsSnapshot {
+        std::string typeName;
+        size_t typeSize{0};
+        uint64_t allocations{0};
+        uint64_t deallocations{0};
+        uint64_t liveCount{0};
+        uint64_t liveBytes{0};
+        uint64_t peakCount{0};
+        uint64_t peakBytes{0};
+        uint64_t totalBytes{0};
+        //allocation calls per second since the previous sample
+        double allocationRate{0.};
+    };
+    
+    class IAllocationStats : public IAllocaitonMiddleware {
+    public:
+        AllocationMiddlewareType getType() const override { return STATS; }
+        virtual AllocationStatsSnapshot sample() = 0;
+        virtual void resetPeaks() = 0;
+    };
+    
+    //Relaxed atomic counters only, cheap enough to leave on in production and safe with THREAD_CACHED_POOL.
+    //Counts are in objects of T, bytes are count * sizeof(T) and don't include pool overhead.
+    template< typename T >
+    class AllocationStats final : public IAllocationStats {
+    public:
+        
+        AllocationStats():
+            mLastSampleTime(std::chrono::steady_clock::now())
+        {}
+        
+        void onAllocation(void* allocatedPtr, size_t count) override
+        {
+            mAllocations.fetch_add(1, std::memory_order_relaxed);
+            mTotalBytes.fetch_add(count * sizeof(T), std::memory_order_relaxed);
+            auto live = mLiveCount.fetch_add(count, std::memory_order_relaxed) + count;
+            auto peak = mPeakCount.load(std::memory_order_relaxed);
+            while(live > peak && !mPeakCount.compare_exchange_weak(peak, live, std::memory_order_relaxed)){}
+        }
+        
+        void onDeallocation(void* ptr, size_t count) override
+        {
+            mDeallocations.fetch_add(1, std::memory_order_relaxed);
+            mLiveCount.fetch_sub(count, std::memory_order_relaxed);
+        }
+        
+        AllocationStatsSnapshot sample() override
+        {
+            AllocationStatsSnapshot ret;
+            ret.typeName = typeid(T).name();
+            ret.typeSize = sizeof(T);
+            ret.allocations = mAllocations.load(std::memory_order_relaxed);
+            ret.deallocations = mDeallocations.load(std::memory_order_relaxed);
+            ret.liveCount = mLiveCount.load(std::memory_order_relaxed);
+            ret.liveBytes = ret.liveCount * sizeof(T);
+            ret.peakCount = mPeakCount.load(std::memory_order_relaxed);
+            ret.peakBytes = ret.peakCount * sizeof(T);
+            ret.totalBytes = mTotalBytes.load(std::memory_order_relaxed);
+            
+            std::lock_guard<std::mutex> lock(mSampleMutex);
+            auto now = std::chrono::steady_clock::now();
+            auto seconds = std::chrono::duration<double>(now - mLastSampleTime).count();
+            if(seconds > 0.){
+                ret.allocationRate = (ret.allocations - mLastSampleAllocations) / seconds;
+            }
+            mLastSampleTime = now;
+            mLastSampleAllocations = ret.allocations;
+            return ret;
+        }
+        
+        //starts a new high-water window from the current live count
+        void resetPeaks() override
+        {
+            mPeakCount.store(mLiveCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        
+    private:
+        std::atomic<uint64_t> mAllocations{0};
+        std::atomic<uint64_t> mDeallocations{0};
+        std::atomic<uint64_t> mLiveCount{0};
+        std::atomic<uint64_t> mPeakCount{0};
+        std::atomic<uint64_t> mTotalBytes{0};
+        
+        std::mutex mSampleMutex;
+        std::chrono::steady_clock::time_point mLastSampleTime;
+        uint64_t mLastSampleAllocations{0};
+    };
+    
+    //readable name for reports, falls back to the mangled name
+    inline std::string demangleTypeName(const char* name){
+#if __has_include(<cxxabi.h>)
+        int status = 0;
+        auto demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        if(status == 0 && demangled){
+            std::string ret(demangled);
+            std::free(demangled);
+            return ret;
+        }
+#endif
+        return name;
+    }
+    
+    struct OutstandingAllocation {
+        void* ptr{nullptr};
+        size_t count{0};
+        //order of allocation within the tracked type
+        uint64_t sequence{0};
+        //symbolized frames, empty unless backtraces were requested and are supported
+        std::vector<std::string> backtrace;
+    };
+    
+#if defined(MS_ALLOW_LEAK_TRACKING)
+    
+    class IAllocationLeakTracker : public IAllocaitonMiddleware {
+    public:
+        AllocationMiddlewareType getType() const override { return LEAK_TRACKER; }
+        virtual std::string getTypeName() const = 0;
+        virtual size_t getTypeSize() const = 0;
+        virtual std::vector<OutstandingAllocation> getOutstanding() const = 0;
+        virtual bool capturesBacktraces() const = 0;
+    };
+    
+    //Remembers every live allocation of T, optionally with the call stack that made it.
+    //Takes a lock per allocation and a backtrace costs microseconds, meant for debug builds and tests.
+    template< typename T >
+    class AllocationLeakTracker final : public IAllocationLeakTracker {
+    public:
+        
+        static const int MAX_FRAMES = 32;
+        
+        explicit AllocationLeakTracker(bool captureBacktraces = false):
+            mCaptureBacktraces(captureBacktraces)
+        {}
+        
+        void onAllocation(void* allocatedPtr, size_t count) override
+        {
+            if(!allocatedPtr)
+                return;
+            Record record;
+            record.count = count;
+#if defined(MS_HAS_ALLOCATION_BACKTRACE)
+            if(mCaptureBacktraces){
+                record.frames.resize(MAX_FRAMES);
+                record.frames.resize(::backtrace(record.frames.data(), MAX_FRAMES));
+            }
+#endif
+            std::lock_guard<std::mutex> lock(mMutex);
+            record.sequence = mSequence++;
+            mLive[allocatedPtr] = std::move(record);
+        }
+        
+        void onDeallocation(void* ptr, size_t count) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mLive.erase(ptr);
+        }
+        
+        std::string getTypeName() const override { return demangleTypeName(typeid(T).name()); }
+        size_t getTypeSize() const override { return sizeof(T); }
+        bool capturesBacktraces() const override { return mCaptureBacktraces; }
+        
+        std::vector<OutstandingAllocation> getOutstanding() const override
+        {
+            std::vector<OutstandingAllocation> ret;
+            std::lock_guard<std::mutex> lock(mMutex);
+            ret.reserve(mLive.size());
+            for(auto & live : mLive){
+                OutstandingAllocation allocation;
+                allocation.ptr = live.first;
+                allocation.count = live.second.count;
+                allocation.sequence = live.second.sequence;
+#if defined(MS_HAS_ALLOCATION_BACKTRACE)
+                auto& frames = live.second.frames;
+                if(!frames.empty()){
+                    if(auto symbols = ::backtrace_symbols(frames.data(), static_cast<int>(frames.size()))){
+                        //skip the tracker and policy frames
+                        for(size_t i = std::min<size_t>(2, frames.size()); i < frames.size(); i++){
+                            allocation.backtrace.emplace_back(symbols[i]);
+                        }
+                        std::free(symbols);
+                    }
+                }
+#endif
+                ret.push_back(std::move(allocation));
+            }
+            std::sort(ret.begin(), ret.end(), [](const OutstandingAllocation& a, const OutstandingAllocation& b){ return a.sequence < b.sequence; });
+            return ret;
+        }
+        
+    private:
+        
+        struct Record {
+            size_t count{0};
+            uint64_t sequence{0};
+            std::vector<void*> frames;
+        };
+        
+        const bool mCaptureBacktraces;
+        mutable std::mutex mMutex;
+        std::unordered_map<void*, Record> mLive;
+        uint64_t mSequence{0};
+    };
+    
+#endif
         
 }//end namespace mediasystem
@@ -10,7 +10,10 @@
 #include <stdint.h>
 #include <cstddef>
 #include <iostream>
+#include <tuple>
+#include <type_traits>
 #include "Storage.hpp"
+#include "MappedStorage.hpp"
 #include "AllocationStrategies.hpp"
 #include "AllocationMiddleware.hpp"
 
@@ -27,6 +30,26 @@ namespace mediasystem {
 
         AllocationPolicyFormat& defaultHeapStrategy(){ strategy = AllocationStrategyType::DEFAULT_HEAP; return *this; }
         AllocationPolicyFormat& unreclaimedPoolStrategy(){ strategy = AllocationStrategyType::UNRECLAIMED_POOL; return *this; }
+        //requires blockListStorage, frees blocks once more than emptyBlockWatermark of them are empty
+        AllocationPolicyFormat& slabPoolStrategy(size_t emptyBlockWatermark = 1){
+            strategy = AllocationStrategyType::SLAB_POOL;
+            slabEmptyBlockWatermark = emptyBlockWatermark;
+            return *this;
+        }
+        //safe to use from any thread, works with any storage type
+        AllocationPolicyFormat& threadCachedPoolStrategy(size_t magazineSize = ThreadCachedPool::DEFAULT_MAGAZINE_SIZE){
+            strategy = AllocationStrategyType::THREAD_CACHED_POOL;
+            threadMagazineSize = magazineSize;
+            return *this;
+        }
+        //pools count > 1 requests up to maxClassObjects, works with any storage type
+        AllocationPolicyFormat& sizeClassPoolStrategy(size_t maxClassObjects = SizeClassPool::DEFAULT_MAX_CLASS_OBJECTS){
+            strategy = AllocationStrategyType::SIZE_CLASS_POOL;
+            sizeClassMaxObjects = maxClassObjects;
+            return *this;
+        }
+        //bump allocation released all at once by AllocationManager::resetArenas(), works with any storage type
+        AllocationPolicyFormat& frameArenaStrategy(){ strategy = AllocationStrategyType::FRAME_ARENA; return *this; }
         AllocationPolicyFormat& noStorage(){ storage = AllocationStorageType::NO_STORAGE; return *this; }
         AllocationPolicyFormat& fixedSizeStorage(size_t size){ storageSize = size; requestedStorageSize = size; storage = AllocationStorageType::FIXED_SIZE_STORAGE; return *this; }
         AllocationPolicyFormat& blockListStorage(size_t size, size_t initial_count = 1){
@@ -36,22 +59,50 @@ namespace mediasystem {
             storage = AllocationStorageType::BLOCK_LIST_STORAGE;
             return *this;
         }
+        //fixed size storage mapped from the OS, see MappedStorageOptions for huge pages, prefaulting and NUMA binding
+        AllocationPolicyFormat& mappedStorage(size_t size, const MappedStorageOptions& options = MappedStorageOptions()){
+            storageSize = size;
+            requestedStorageSize = size;
+            mappedOptions = options;
+            storage = AllocationStorageType::MAPPED_STORAGE;
+            return *this;
+        }
 
         AllocationStrategyType strategy{AllocationStrategyType::DEFAULT_HEAP};
         AllocationStorageType storage{AllocationStorageType::NO_STORAGE};
         size_t storageSize{0};
         size_t storageInitialCount{1};
         size_t requestedStorageSize{0};
+        size_t slabEmptyBlockWatermark{1};
+        size_t threadMagazineSize{ThreadCachedPool::DEFAULT_MAGAZINE_SIZE};
+        size_t sizeClassMaxObjects{SizeClassPool::DEFAULT_MAX_CLASS_OBJECTS};
+        MappedStorageOptions mappedOptions;
+        bool leakTrackerBacktraces{false};
         AllocationPolicyFormat& addConsoleLoggerMiddleware(){ middleware[AllocationMiddlewareType::CONSOLE_LOGGER] = AllocationMiddlewareType::CONSOLE_LOGGER; return *this; }
+        //live/peak counters per type, see AllocationManager::report()
+        AllocationPolicyFormat& addStatsMiddleware(){ middleware[AllocationMiddlewareType::STATS] = AllocationMiddlewareType::STATS; return *this; }
+        //tracks every live allocation for AllocationManager::reportLeaks(), compiled out without MS_ALLOW_LEAK_TRACKING
+        AllocationPolicyFormat& addLeakTrackerMiddleware(bool captureBacktraces = false){
+            middleware[AllocationMiddlewareType::LEAK_TRACKER] = AllocationMiddlewareType::LEAK_TRACKER;
+            leakTrackerBacktraces = captureBacktraces;
+            return *this;
+        }
         std::array<AllocationMiddlewareType,AllocationMiddlewareType::NO_MIDDLEWARE> middleware;
         
     };
     
     class IAllocationPolicy {
     public:
+        virtual ~IAllocationPolicy() = default;
         virtual void initialize() = 0;
         virtual void* allocate(size_t count) = 0;
         virtual void deallocate(void* ptr, size_t count) = 0;
+        //releases everything a FRAME_ARENA handed out, a no-op for other strategies
+        virtual void reset() = 0;
+        //repacks free slots towards the front of the storage, see IAllocationStrategy::compact
+        virtual void compact() = 0;
+        //storage index of ptr, IMemoryStorage::npos if the policy's storage doesn't hold it
+        virtual size_t getStorageIndex(const void* ptr) const = 0;
         virtual AllocationStrategyType getStrategyType() const = 0;
         virtual AllocationStorageType getStorageType() const = 0;
         virtual size_t getRequestedStorageSize() const = 0;
@@ -61,10 +112,11 @@ namespace mediasystem {
         virtual AllocationPolicyFormat getFormat() const = 0;
         virtual std::vector<AllocationMiddlewareType> getMiddlewareTypes() const = 0;
         virtual void addMiddleware( std::unique_ptr<IAllocaitonMiddleware>&& middleware ) = 0;
+        virtual IAllocaitonMiddleware* getMiddleware( AllocationMiddlewareType type ) const = 0;
     };
     
     template<typename Strategy, typename Storage>
-    class AllocationPolicy : public IAllocationPolicy {
+    class AllocationPolicy final : public IAllocationPolicy {
     public:
         
         template<typename...Args>
@@ -103,10 +155,34 @@ namespace mediasystem {
 #endif
         }
         
+        void reset() override
+        {
+            if(mInitialized)
+                mStrategy.reset( mStorage );
+        }
+        
+        void compact() override
+        {
+            if(mInitialized)
+                mStrategy.compact( mStorage );
+        }
+        
+        size_t getStorageIndex(const void* ptr) const override
+        {
+            return mInitialized ? mStorage.indexOf(ptr) : IMemoryStorage::npos;
+        }
+        
         void addMiddleware( std::unique_ptr<IAllocaitonMiddleware>&& middleware )override{
             mMiddlewares[middleware->getType()] = std::move(middleware);
         }
         
+        IAllocaitonMiddleware* getMiddleware( AllocationMiddlewareType type ) const override {
+            return type < mMiddlewares.size() ? mMiddlewares[type].get() : nullptr;
+        }
+        
+        inline Strategy& getStrategy(){ return mStrategy; }
+        inline Storage& getStorage(){ return mStorage; }
+        
         AllocationStrategyType getStrategyType() const override { return mStrategy.getType(); }
         AllocationStorageType getStorageType() const override { { return mStorage.getType(); } }
         size_t getRequestedStorageSize() const override { return mStorage.getRequestedStorageSize(); }
@@ -132,6 +208,18 @@ namespace mediasystem {
             fmt.storageSize = mStorage.getStorageSize();
             fmt.requestedStorageSize = mStorage.getRequestedStorageSize();
             fmt.storageInitialCount = mStorage.getStorageInitialCount();
+            if constexpr (std::is_same<Strategy, SlabPool>::value){
+                fmt.slabEmptyBlockWatermark = mStrategy.getEmptyBlockWatermark();
+            }
+            if constexpr (std::is_same<Strategy, ThreadCachedPool>::value){
+                fmt.threadMagazineSize = mStrategy.getMagazineSize();
+            }
+            if constexpr (std::is_same<Strategy, SizeClassPool>::value){
+                fmt.sizeClassMaxObjects = mStrategy.getMaxClassObjects();
+            }
+            if constexpr (std::is_same<Storage, MappedStorage>::value){
+                fmt.mappedOptions = mStorage.getOptions();
+            }
             size_t i = 0;
             for(auto & middleware: mMiddlewares){
                 if(middleware){
@@ -141,6 +229,11 @@ namespace mediasystem {
                 }
                 ++i;
             }
+#if defined(MS_ALLOW_LEAK_TRACKING)
+            if(auto tracker = static_cast<IAllocationLeakTracker*>(getMiddleware(LEAK_TRACKER))){
+                fmt.leakTrackerBacktraces = tracker->capturesBacktraces();
+            }
+#endif
             return fmt;
         }
 
@@ -153,7 +246,7 @@ namespace mediasystem {
     };
     
     template<typename T>
-    class DefaultHeapAllocation : public IAllocationPolicy {
+    class DefaultHeapAllocation final : public IAllocationPolicy {
     public:
         
         void initialize() override {}
@@ -181,10 +274,18 @@ namespace mediasystem {
 #endif
         }
         
+        void reset() override {}
+        void compact() override {}
+        size_t getStorageIndex(const void* ptr) const override { return IMemoryStorage::npos; }
+        
         void addMiddleware( std::unique_ptr<IAllocaitonMiddleware>&& middleware ) override {
             mMiddlewares[middleware->getType()] = std::move(middleware);
         }
         
+        IAllocaitonMiddleware* getMiddleware( AllocationMiddlewareType type ) const override {
+            return type < mMiddlewares.size() ? mMiddlewares[type].get() : nullptr;
+        }
+        
         AllocationStrategyType getStrategyType() const override { return DEFAULT_HEAP; }
         AllocationStorageType getStorageType() const override { { return NO_STORAGE; } }
         size_t getStorageSize() const override { return 0; }
@@ -214,6 +315,11 @@ namespace mediasystem {
                 }
                 ++i;
             }
+#if defined(MS_ALLOW_LEAK_TRACKING)
+            if(auto tracker = static_cast<IAllocationLeakTracker*>(getMiddleware(LEAK_TRACKER))){
+                fmt.leakTrackerBacktraces = tracker->capturesBacktraces();
+            }
+#endif
             return fmt;
         }
         
@@ -222,6 +328,144 @@ namespace mediasystem {
     };
     
     
+    //Strategy, storage and middleware fixed at compile time. The class and all of its parts are final,
+    //so calls made through a StaticAllocationPolicy pointer (see StaticAllocator) are direct and the
+    //strategy's fast path inlines into the caller. It is still an IAllocationPolicy so it can be
+    //owned and reported by an AllocationManager like any other policy. Runtime settings such as
+    //storage size or a slab watermark come from the format, the strategy and storage types must match it.
+    template<typename Strategy, typename Storage, typename...Middleware>
+    class StaticAllocationPolicy final : public IAllocationPolicy {
+    public:
+        
+        StaticAllocationPolicy(size_t objectSize, const AllocationPolicyFormat& fmt):
+            mStorage(createStorage(objectSize, fmt))
+        {
+            if constexpr (std::is_same<Strategy, SlabPool>::value){
+                mStrategy.setEmptyBlockWatermark(fmt.slabEmptyBlockWatermark);
+            }
+            if constexpr (std::is_same<Strategy, ThreadCachedPool>::value){
+                mStrategy.setMagazineSize(fmt.threadMagazineSize);
+            }
+            if constexpr (std::is_same<Strategy, SizeClassPool>::value){
+                mStrategy.setMaxClassObjects(fmt.sizeClassMaxObjects);
+            }
+            //always eager, saves a branch per allocation and is required by THREAD_CACHED_POOL
+            initialize();
+        }
+        
+        void initialize() override {
+            mStrategy.initialize();
+            mStorage.initialize();
+        }
+        
+        void* allocate(size_t count) override
+        {
+            auto ret = mStrategy.allocate( count, mStorage );
+#if defined(MS_ALLOW_ALLOCATION_MIDDLEWARE)
+            std::apply([ret, count](auto&...middleware){ (middleware.onAllocation(ret, count), ...); }, mMiddlewares);
+#endif
+            return ret;
+        }
+        
+        void deallocate(void* ptr, size_t count) override
+        {
+            mStrategy.deallocate( ptr, count, mStorage );
+#if defined(MS_ALLOW_ALLOCATION_MIDDLEWARE)
+            std::apply([ptr, count](auto&...middleware){ (middleware.onDeallocation(ptr, count), ...); }, mMiddlewares);
+#endif
+        }
+        
+        void reset() override
+        {
+            mStrategy.reset( mStorage );
+        }
+        
+        void compact() override
+        {
+            mStrategy.compact( mStorage );
+        }
+        
+        size_t getStorageIndex(const void* ptr) const override
+        {
+            return mStorage.indexOf(ptr);
+        }
+        
+        void addMiddleware( std::unique_ptr<IAllocaitonMiddleware>&& middleware ) override {
+            ofLogWarning("Memory") << "StaticAllocationPolicy middleware is fixed at compile time, ignoring " << middleware->getType();
+        }
+        
+        IAllocaitonMiddleware* getMiddleware( AllocationMiddlewareType type ) const override {
+            IAllocaitonMiddleware* ret = nullptr;
+            auto match = [&ret, type](const IAllocaitonMiddleware& middleware){
+                if(!ret && middleware.getType() == type)
+                    ret = const_cast<IAllocaitonMiddleware*>(&middleware);
+            };
+            std::apply([&match](const auto&...middleware){ (match(middleware), ...); }, mMiddlewares);
+            return ret;
+        }
+        
+        inline Strategy& getStrategy(){ return mStrategy; }
+        inline Storage& getStorage(){ return mStorage; }
+        
+        AllocationStrategyType getStrategyType() const override { return mStrategy.getType(); }
+        AllocationStorageType getStorageType() const override { return mStorage.getType(); }
+        size_t getRequestedStorageSize() const override { return mStorage.getRequestedStorageSize(); }
+        size_t getStorageSize() const override { return mStorage.getStorageSize(); }
+        size_t getStorageCount() const override { return mStorage.getStorageCount(); }
+        size_t getStorageInitialCount() const override { return mStorage.getStorageInitialCount(); }
+        std::vector<AllocationMiddlewareType> getMiddlewareTypes() const override {
+            std::vector<AllocationMiddlewareType> ret;
+            std::apply([&ret](auto&...middleware){ (ret.push_back(middleware.getType()), ...); }, mMiddlewares);
+            return ret;
+        }
+        
+        AllocationPolicyFormat getFormat() const override {
+            AllocationPolicyFormat fmt;
+            fmt.strategy = mStrategy.getType();
+            fmt.storage = mStorage.getType();
+            fmt.storageSize = mStorage.getStorageSize();
+            fmt.requestedStorageSize = mStorage.getRequestedStorageSize();
+            fmt.storageInitialCount = mStorage.getStorageInitialCount();
+            if constexpr (std::is_same<Strategy, SlabPool>::value){
+                fmt.slabEmptyBlockWatermark = mStrategy.getEmptyBlockWatermark();
+            }
+            if constexpr (std::is_same<Strategy, ThreadCachedPool>::value){
+                fmt.threadMagazineSize = mStrategy.getMagazineSize();
+            }
+            if constexpr (std::is_same<Strategy, SizeClassPool>::value){
+                fmt.sizeClassMaxObjects = mStrategy.getMaxClassObjects();
+            }
+            if constexpr (std::is_same<Storage, MappedStorage>::value){
+                fmt.mappedOptions = mStorage.getOptions();
+            }
+            for(auto type : getMiddlewareTypes()){
+                fmt.middleware[type] = type;
+            }
+#if defined(MS_ALLOW_LEAK_TRACKING)
+            if(auto tracker = static_cast<IAllocationLeakTracker*>(getMiddleware(LEAK_TRACKER))){
+                fmt.leakTrackerBacktraces = tracker->capturesBacktraces();
+            }
+#endif
+            return fmt;
+        }
+        
+    private:
+        
+        static Storage createStorage(size_t objectSize, const AllocationPolicyFormat& fmt){
+            if constexpr (std::is_same<Storage, BlockListStorage>::value){
+                return Storage(objectSize, fmt.requestedStorageSize, fmt.storageInitialCount);
+            }else if constexpr (std::is_same<Storage, MappedStorage>::value){
+                return Storage(objectSize, fmt.requestedStorageSize, fmt.mappedOptions);
+            }else{
+                return Storage(objectSize, fmt.requestedStorageSize);
+            }
+        }
+        
+        Storage mStorage;
+        Strategy mStrategy;
+        std::tuple<Middleware...> mMiddlewares;
+    };
+    
 }//end namspace mediasystem
 
 inline std::ostream& operator<<(std::ostream& stream, const mediasystem::AllocationPolicyFormat& fmt) {
@@ -233,6 +477,21 @@ inline std::ostream& operator<<(std::ostream& stream, const mediasystem::Allocat
         case mediasystem::DEFAULT_HEAP:{
             stream << "\tstrategy - DEFAULT_HEAP\n";
         }break;
+        case mediasystem::SLAB_POOL:{
+            stream << "\tstrategy - SLAB_POOL\n";
+            stream << "\t\tempty block watermark - " << fmt.slabEmptyBlockWatermark << "\n";
+        }break;
+        case mediasystem::THREAD_CACHED_POOL:{
+            stream << "\tstrategy - THREAD_CACHED_POOL\n";
+            stream << "\t\tmagazine size - " << fmt.threadMagazineSize << "\n";
+        }break;
+        case mediasystem::SIZE_CLASS_POOL:{
+            stream << "\tstrategy - SIZE_CLASS_POOL\n";
+            stream << "\t\tmax class objects - " << fmt.sizeClassMaxObjects << "\n";
+        }break;
+        case mediasystem::FRAME_ARENA:{
+            stream << "\tstrategy - FRAME_ARENA\n";
+        }break;
     }
     switch(fmt.storage){
         case mediasystem::NO_STORAGE:{
@@ -250,13 +509,28 @@ inline std::ostream& operator<<(std::ostream& stream, const mediasystem::Allocat
             stream << "\t\tactual size - " << fmt.storageSize << "\n";
             stream << "\t\tinitial count - " << fmt.storageInitialCount<<"\n";
         }break;
+        case mediasystem::MAPPED_STORAGE:{
+            stream << "\tstorage - MAPPED_STORAGE\n";
+            stream << "\t\trequested size - " << fmt.requestedStorageSize << "\n";
+            stream << "\t\tactual size - " << fmt.storageSize << "\n";
+            stream << "\t\thuge pages - " << fmt.mappedOptions.useHugePages << "\n";
+            stream << "\t\tprefault - " << fmt.mappedOptions.prefaultMode << "\n";
+            stream << "\t\tnuma node - " << fmt.mappedOptions.bindNumaNode << "\n";
+        }break;
     }
 #if defined(MS_ALLOW_ALLOCATION_MIDDLEWARE)
     for(auto & m : fmt.middleware){
         switch(m){
             case mediasystem::CONSOLE_LOGGER:{
                 stream << "\tmiddleware: CONSOLE_LOGGER\n";
-            }
+            }break;
+            case mediasystem::STATS:{
+                stream << "\tmiddleware: STATS\n";
+            }break;
+            case mediasystem::LEAK_TRACKER:{
+                stream << "\tmiddleware: LEAK_TRACKER\n";
+                stream << "\t\tbacktraces - " << fmt.leakTrackerBacktraces << "\n";
+            }break;
             default: break;
         }
     }
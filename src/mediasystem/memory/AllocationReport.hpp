@@ -0,0 +1,171 @@
+//
+//  AllocationReport.hpp
+//  ofxMediaSystem
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include "AllocationStrategies.hpp"
+#include "Storage.hpp"
+#include "AllocationMiddleware.hpp"
+
+namespace mediasystem {
+    
+    //Snapshot of every policy with STATS middleware in one AllocationManager
+    struct AllocationReport {
+        
+        struct Entry {
+            AllocationStatsSnapshot stats;
+            AllocationStrategyType strategy{DEFAULT_HEAP};
+            AllocationStorageType storage{NO_STORAGE};
+            //bytes held by the policy's storage, the high-water mark for pooled types
+            size_t reservedBytes{0};
+        };
+        
+        std::string name;
+        std::vector<Entry> entries;
+        
+        uint64_t getLiveBytes() const {
+            uint64_t ret = 0;
+            for(auto & entry : entries){
+                ret += entry.stats.liveBytes;
+            }
+            return ret;
+        }
+        
+        uint64_t getReservedBytes() const {
+            uint64_t ret = 0;
+            for(auto & entry : entries){
+                ret += entry.reservedBytes;
+            }
+            return ret;
+        }
+        
+        std::string toCsv(bool header = true) const {
+            std::stringstream ss;
+            if(header){
+                ss << "name,type,type_size,strategy,storage,allocations,deallocations,live_count,live_bytes,peak_count,peak_bytes,total_bytes,reserved_bytes,allocation_rate\n";
+            }
+            for(auto & entry : entries){
+                auto& stats = entry.stats;
+                ss << name << ","
+                << stats.typeName << ","
+                << stats.typeSize << ","
+                << getStrategyName(entry.strategy) << ","
+                << getStorageName(entry.storage) << ","
+                << stats.allocations << ","
+                << stats.deallocations << ","
+                << stats.liveCount << ","
+                << stats.liveBytes << ","
+                << stats.peakCount << ","
+                << stats.peakBytes << ","
+                << stats.totalBytes << ","
+                << entry.reservedBytes << ","
+                << stats.allocationRate << "\n";
+            }
+            return ss.str();
+        }
+        
+        std::string toJson() const {
+            std::stringstream ss;
+            ss << "{\"name\":\"" << escape(name) << "\",\"entries\":[";
+            for(size_t i = 0; i < entries.size(); i++){
+                auto& entry = entries[i];
+                auto& stats = entry.stats;
+                if(i) ss << ",";
+                ss << "{\"type\":\"" << escape(stats.typeName) << "\""
+                << ",\"typeSize\":" << stats.typeSize
+                << ",\"strategy\":\"" << getStrategyName(entry.strategy) << "\""
+                << ",\"storage\":\"" << getStorageName(entry.storage) << "\""
+                << ",\"allocations\":" << stats.allocations
+                << ",\"deallocations\":" << stats.deallocations
+                << ",\"liveCount\":" << stats.liveCount
+                << ",\"liveBytes\":" << stats.liveBytes
+                << ",\"peakCount\":" << stats.peakCount
+                << ",\"peakBytes\":" << stats.peakBytes
+                << ",\"totalBytes\":" << stats.totalBytes
+                << ",\"reservedBytes\":" << entry.reservedBytes
+                << ",\"allocationRate\":" << stats.allocationRate << "}";
+            }
+            ss << "]}";
+            return ss.str();
+        }
+        
+        static const char* getStrategyName(AllocationStrategyType strategy){
+            switch(strategy){
+                case DEFAULT_HEAP: return "DEFAULT_HEAP";
+                case UNRECLAIMED_POOL: return "UNRECLAIMED_POOL";
+                case SLAB_POOL: return "SLAB_POOL";
+                case THREAD_CACHED_POOL: return "THREAD_CACHED_POOL";
+                case SIZE_CLASS_POOL: return "SIZE_CLASS_POOL";
+                case FRAME_ARENA: return "FRAME_ARENA";
+            }
+            return "UNKNOWN";
+        }
+        
+        static const char* getStorageName(AllocationStorageType storage){
+            switch(storage){
+                case FIXED_SIZE_STORAGE: return "FIXED_SIZE_STORAGE";
+                case BLOCK_LIST_STORAGE: return "BLOCK_LIST_STORAGE";
+                case NO_STORAGE: return "NO_STORAGE";
+                case MAPPED_STORAGE: return "MAPPED_STORAGE";
+            }
+            return "UNKNOWN";
+        }
+        
+    private:
+        
+        static std::string escape(const std::string& str){
+            std::string ret;
+            ret.reserve(str.size());
+            for(auto c : str){
+                if(c == '"' || c == '\\')
+                    ret.push_back('\\');
+                ret.push_back(c);
+            }
+            return ret;
+        }
+    };
+    
+    //Allocations still alive in every policy with a LEAK_TRACKER, empty when middleware is compiled out
+    struct AllocationLeakReport {
+        
+        struct Entry {
+            std::string typeName;
+            size_t typeSize{0};
+            std::vector<OutstandingAllocation> outstanding;
+        };
+        
+        std::string name;
+        std::vector<Entry> entries;
+        
+        bool empty() const { return entries.empty(); }
+        
+        size_t getNumOutstanding() const {
+            size_t ret = 0;
+            for(auto & entry : entries){
+                ret += entry.outstanding.size();
+            }
+            return ret;
+        }
+        
+        std::string toString() const {
+            std::stringstream ss;
+            ss << "[AllocationLeakReport] " << name << " - " << getNumOutstanding() << " outstanding allocations\n";
+            for(auto & entry : entries){
+                ss << "\t" << entry.typeName << " [size: " << entry.typeSize << "] - " << entry.outstanding.size() << "\n";
+                for(auto & allocation : entry.outstanding){
+                    ss << "\t\t#" << allocation.sequence << " " << allocation.ptr << " count: " << allocation.count << "\n";
+                    for(auto & frame : allocation.backtrace){
+                        ss << "\t\t\t" << frame << "\n";
+                    }
+                }
+            }
+            return ss.str();
+        }
+    };
+    
+}//end namespace mediasystem
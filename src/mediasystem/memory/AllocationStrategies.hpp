@@ -10,22 +10,35 @@
 #include <cstring>
 #include <stdint.h>
 #include <memory>
+#include <set>
+#include <array>
+#include <unordered_set>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <functional>
 #include "Storage.hpp"
 
 namespace mediasystem {
     
-    enum AllocationStrategyType { DEFAULT_HEAP, UNRECLAIMED_POOL };
+    enum AllocationStrategyType { DEFAULT_HEAP, UNRECLAIMED_POOL, SLAB_POOL, THREAD_CACHED_POOL, SIZE_CLASS_POOL, FRAME_ARENA };
     
     class IAllocationStrategy {
     public:
+        virtual ~IAllocationStrategy() = default;
         virtual void initialize() = 0;
         virtual void* allocate( size_t count, IMemoryStorage& storage ) = 0;
         virtual void deallocate( void* ptr, size_t count, IMemoryStorage& storage ) = 0;
         virtual bool canReclaim() const = 0;
         virtual AllocationStrategyType getType() const = 0;
+        //only arenas give memory back on reset, everything else frees per object
+        virtual void reset( IMemoryStorage& storage ){}
+        //orders free slots so the next allocations come from the front of the storage and
+        //gives trailing storage back where the strategy is able to
+        virtual void compact( IMemoryStorage& storage ){}
     };
     
-    class UnreclaimedPool : public IAllocationStrategy {
+    class UnreclaimedPool final : public IAllocationStrategy {
     public:
         
         AllocationStrategyType getType() const override { return UNRECLAIMED_POOL; }
@@ -58,11 +71,558 @@ namespace mediasystem {
         }
         
         bool canReclaim() const override { return false; }
+        
+        //sorts the free list by storage index, rewinds the bump index over a free tail and frees
+        //block list blocks past it, the initial blocks are kept
+        void compact( IMemoryStorage& storage ) override {
+            std::vector<std::pair<size_t, void*>> free;
+            for(auto node = mFreeStore; node; node = *reinterpret_cast<void**>(node)){
+                free.emplace_back(storage.indexOf(node), node);
+            }
+            std::sort(free.begin(), free.end());
+            while(!free.empty() && mLast > 0 && free.back().first == mLast - 1){
+                free.pop_back();
+                --mLast;
+            }
+            if(storage.getType() == BLOCK_LIST_STORAGE){
+                auto& blocks = static_cast<BlockListStorage&>(storage);
+                auto perBlock = blocks.objectsPerBlock();
+                auto firstUnused = std::max((mLast + perBlock - 1) / perBlock, blocks.getStorageInitialCount());
+                for(size_t i = firstUnused; i < blocks.getNumBlockSlots(); i++){
+                    blocks.freeBlock(i);
+                }
+            }
+            mFreeStore = nullptr;
+            for(auto it = free.rbegin(); it != free.rend(); ++it){
+                *reinterpret_cast<void**>(it->second) = mFreeStore;
+                mFreeStore = it->second;
+            }
+        }
     
     private:
         void* mFreeStore{nullptr};
         size_t mLast{0};
     };
     
+    //Pool over BlockListStorage that tracks occupancy per block. Allocations come from the lowest
+    //block with room so live objects pack towards the front, and once more than the watermark of
+    //blocks are completely empty the extra ones are handed back to the storage and freed.
+    class SlabPool final : public IAllocationStrategy {
+    public:
+        
+        AllocationStrategyType getType() const override { return SLAB_POOL; }
+        
+        void initialize() override {
+            mSlabs.clear();
+            mPartial.clear();
+            mReleased.clear();
+            mEmptyBlocks = 0;
+        }
+        
+        void* allocate( size_t count, IMemoryStorage& storage ) override {
+            if(count != 1){
+                return ::operator new(count * storage.objectSize(), ::std::nothrow);
+            }
+            auto& blocks = blockStorage(storage);
+            if(mPartial.empty()){
+                acquireBlock(blocks);
+            }
+            auto index = *mPartial.begin();
+            auto& slab = mSlabs[index];
+            
+            void* ret;
+            if(slab.freeList){
+                ret = slab.freeList;
+                slab.freeList = *reinterpret_cast<void**>(slab.freeList);
+            }else{
+                ret = blocks[index * blocks.objectsPerBlock() + slab.bumped++];
+            }
+            
+            if(slab.used++ == 0){
+                --mEmptyBlocks;
+            }
+            if(slab.used == blocks.objectsPerBlock()){
+                mPartial.erase(mPartial.begin());
+            }
+            return ret;
+        }
+        
+        void deallocate(void* ptr, size_t count, IMemoryStorage& storage) override {
+            if(count != 1){
+                ::operator delete(ptr);
+                return;
+            }
+            auto& blocks = blockStorage(storage);
+            auto index = blocks.getBlockIndex(ptr);
+            assert(index != BlockListStorage::npos && "SlabPool deallocating a pointer it doesn't own");
+            
+            auto& slab = mSlabs[index];
+            *reinterpret_cast<void**>(ptr) = slab.freeList;
+            slab.freeList = ptr;
+            if(slab.used-- == blocks.objectsPerBlock()){
+                mPartial.insert(index);
+            }
+            if(slab.used == 0 && ++mEmptyBlocks > mEmptyBlockWatermark){
+                releaseBlock(index, blocks);
+            }
+        }
+        
+        bool canReclaim() const override { return true; }
+        
+        //sorts each block's free list by address and frees every empty block except the lowest
+        //watermark of them, allocations already prefer the lowest partial block
+        void compact( IMemoryStorage& storage ) override {
+            auto& blocks = blockStorage(storage);
+            size_t keptEmpty = 0;
+            for(size_t index = 0; index < mSlabs.size(); index++){
+                if(!blocks.isBlockAllocated(index)){
+                    continue;
+                }
+                auto& slab = mSlabs[index];
+                if(slab.used == 0){
+                    if(++keptEmpty > mEmptyBlockWatermark){
+                        releaseBlock(index, blocks);
+                    }
+                    continue;
+                }
+                std::vector<void*> free;
+                for(auto node = slab.freeList; node; node = *reinterpret_cast<void**>(node)){
+                    free.push_back(node);
+                }
+                std::sort(free.begin(), free.end(), std::greater<void*>());
+                slab.freeList = nullptr;
+                for(auto node : free){
+                    *reinterpret_cast<void**>(node) = slab.freeList;
+                    slab.freeList = node;
+                }
+            }
+        }
+        
+        //number of completely empty blocks kept around for reuse before blocks are freed
+        inline void setEmptyBlockWatermark(size_t numBlocks){ mEmptyBlockWatermark = numBlocks; }
+        inline size_t getEmptyBlockWatermark() const { return mEmptyBlockWatermark; }
+        
+        inline size_t getNumLiveBlocks() const { return mSlabs.size() - mReleased.size(); }
+        inline size_t getNumEmptyBlocks() const { return mEmptyBlocks; }
+        inline size_t getNumReleasedBlocks() const { return mNumReleases; }
+        
+    private:
+        
+        struct Slab {
+            void* freeList{nullptr};
+            size_t used{0};
+            size_t bumped{0};
+        };
+        
+        static BlockListStorage& blockStorage(IMemoryStorage& storage){
+            assert(storage.getType() == BLOCK_LIST_STORAGE && "SlabPool requires BLOCK_LIST_STORAGE");
+            return static_cast<BlockListStorage&>(storage);
+        }
+        
+        //reuses the lowest released slot so the block vector doesn't grow unbounded under churn
+        void acquireBlock(BlockListStorage& blocks){
+            size_t index;
+            if(!mReleased.empty()){
+                index = *mReleased.begin();
+                mReleased.erase(mReleased.begin());
+            }else{
+                index = mSlabs.size();
+                mSlabs.emplace_back();
+            }
+            blocks.ensureBlock(index);
+            mSlabs[index] = Slab();
+            mPartial.insert(index);
+            ++mEmptyBlocks;
+        }
+        
+        void releaseBlock(size_t index, BlockListStorage& blocks){
+            blocks.freeBlock(index);
+            mSlabs[index] = Slab();
+            mPartial.erase(index);
+            mReleased.insert(index);
+            --mEmptyBlocks;
+            ++mNumReleases;
+        }
+        
+        std::vector<Slab> mSlabs;
+        std::set<size_t> mPartial;
+        std::set<size_t> mReleased;
+        size_t mEmptyBlocks{0};
+        size_t mEmptyBlockWatermark{1};
+        size_t mNumReleases{0};
+    };
+    
 
+    //Pool that is safe to allocate from and free to on any thread. Each thread keeps a magazine of free
+    //objects per pool and only takes the depot lock to refill or flush half a magazine at a time.
+    //Objects freed on another thread than they were allocated on simply join that thread's magazine.
+    class ThreadCachedPool final : public IAllocationStrategy {
+    public:
+        
+        static constexpr size_t DEFAULT_MAGAZINE_SIZE = 32;
+        
+        ThreadCachedPool():
+            mDepot(std::make_shared<Depot>())
+        {}
+        
+        ~ThreadCachedPool(){
+            //magazines still held by other threads are dropped instead of returned
+            std::lock_guard<std::mutex> lock(mDepot->mutex);
+            mDepot->alive = false;
+        }
+        
+        AllocationStrategyType getType() const override { return THREAD_CACHED_POOL; }
+        
+        void initialize() override {}
+        
+        void* allocate( size_t count, IMemoryStorage& storage ) override {
+            if(count != 1){
+                return ::operator new(count * storage.objectSize(), ::std::nothrow);
+            }
+            auto& cache = localCache();
+            if(cache.count == 0){
+                refill(cache, storage);
+            }
+            return cache.items[--cache.count];
+        }
+        
+        void deallocate(void* ptr, size_t count, IMemoryStorage& storage) override {
+            if(count != 1){
+                ::operator delete(ptr);
+                return;
+            }
+            auto& cache = localCache();
+            if(cache.count == cache.items.size()){
+                flush(cache, cache.items.size() / 2);
+            }
+            cache.items[cache.count++] = ptr;
+        }
+        
+        bool canReclaim() const override { return false; }
+        
+        //takes effect for threads that haven't touched the pool yet
+        inline void setMagazineSize(size_t size){ mMagazineSize = std::max<size_t>(size, 2); }
+        inline size_t getMagazineSize() const { return mMagazineSize; }
+        
+        size_t getNumDepotObjects() const {
+            std::lock_guard<std::mutex> lock(mDepot->mutex);
+            return mDepot->free.size();
+        }
+        
+    private:
+        
+        struct Depot {
+            mutable std::mutex mutex;
+            std::vector<void*> free;
+            size_t last{0};
+            bool alive{true};
+        };
+        
+        struct Magazine {
+            Magazine(std::shared_ptr<Depot> d, size_t size):depot(std::move(d)),items(size, nullptr){}
+            ~Magazine(){
+                std::lock_guard<std::mutex> lock(depot->mutex);
+                if(depot->alive){
+                    depot->free.insert(depot->free.end(), items.begin(), items.begin() + count);
+                }
+            }
+            std::shared_ptr<Depot> depot;
+            std::vector<void*> items;
+            size_t count{0};
+        };
+        
+        struct ThreadMagazines {
+            std::vector<std::unique_ptr<Magazine>> magazines;
+            Magazine* last{nullptr};
+        };
+        
+        Magazine& localCache(){
+            static thread_local ThreadMagazines local;
+            if(local.last && local.last->depot == mDepot){
+                return *local.last;
+            }
+            for(auto & magazine : local.magazines){
+                if(magazine->depot == mDepot){
+                    local.last = magazine.get();
+                    return *magazine;
+                }
+            }
+            //first use of this pool on this thread, drop magazines of pools that are gone
+            local.magazines.erase(std::remove_if(local.magazines.begin(), local.magazines.end(), [](const std::unique_ptr<Magazine>& magazine){
+                std::lock_guard<std::mutex> lock(magazine->depot->mutex);
+                if(!magazine->depot->alive){
+                    magazine->count = 0;
+                    return true;
+                }
+                return false;
+            }), local.magazines.end());
+            local.magazines.emplace_back(new Magazine(mDepot, mMagazineSize));
+            local.last = local.magazines.back().get();
+            return *local.last;
+        }
+        
+        void refill(Magazine& magazine, IMemoryStorage& storage){
+            auto want = magazine.items.size() / 2;
+            std::lock_guard<std::mutex> lock(mDepot->mutex);
+            auto& free = mDepot->free;
+            while(magazine.count < want && !free.empty()){
+                magazine.items[magazine.count++] = free.back();
+                free.pop_back();
+            }
+            try{
+                while(magazine.count < want){
+                    magazine.items[magazine.count++] = storage[mDepot->last];
+                    ++mDepot->last;
+                }
+            }catch(const std::bad_alloc&){
+                //fixed storage ran out, hand out what we have
+                if(magazine.count == 0)
+                    throw;
+            }
+        }
+        
+        void flush(Magazine& magazine, size_t numObjects){
+            std::lock_guard<std::mutex> lock(mDepot->mutex);
+            auto begin = magazine.items.begin() + (magazine.count - numObjects);
+            mDepot->free.insert(mDepot->free.end(), begin, magazine.items.begin() + magazine.count);
+            magazine.count -= numObjects;
+        }
+        
+        std::shared_ptr<Depot> mDepot;
+        size_t mMagazineSize{DEFAULT_MAGAZINE_SIZE};
+    };
+    
+    //Serves count > 1 requests from the pool as well, so containers using ms_Allocator stay pooled.
+    //Requests are rounded up to power of two object counts and each class keeps its own free list.
+    //Chunks are carved from contiguous storage indices and never straddle a block, the tail of a
+    //block that can't fit the next chunk is split into smaller classes instead of wasted.
+    //Requests above the largest class, or made after fixed storage is exhausted, go to the heap.
+    class SizeClassPool final : public IAllocationStrategy {
+    public:
+        
+        static constexpr size_t MAX_CLASSES = 16;
+        static constexpr size_t DEFAULT_MAX_CLASS_OBJECTS = 256;
+        
+        AllocationStrategyType getType() const override { return SIZE_CLASS_POOL; }
+        
+        void initialize() override {
+            mFreeLists.fill(nullptr);
+            mLast = 0;
+        }
+        
+        ~SizeClassPool(){
+            for(auto ptr : mHeapChunks){
+                ::operator delete(ptr);
+            }
+        }
+        
+        void* allocate( size_t count, IMemoryStorage& storage ) override {
+            auto sizeClass = classFor(count);
+            if(sizeClass >= mNumClasses || (size_t(1) << sizeClass) > objectsPerRun(storage)){
+                ++mHeapFallbacks;
+                return ::operator new(count * storage.objectSize(), ::std::nothrow);
+            }
+            ++mPooledAllocations;
+            if(auto ret = mFreeLists[sizeClass]){
+                mFreeLists[sizeClass] = *reinterpret_cast<void**>(ret);
+                return ret;
+            }
+            try{
+                return carve(sizeClass, storage);
+            }catch(const std::bad_alloc&){
+                //fixed storage is full, keep the chunk pooled once it is freed
+                --mPooledAllocations;
+                ++mHeapFallbacks;
+                auto ret = ::operator new((size_t(1) << sizeClass) * storage.objectSize(), ::std::nothrow);
+                if(ret)
+                    mHeapChunks.insert(ret);
+                return ret;
+            }
+        }
+        
+        void deallocate(void* ptr, size_t count, IMemoryStorage& storage) override {
+            auto sizeClass = classFor(count);
+            if(sizeClass >= mNumClasses || (size_t(1) << sizeClass) > objectsPerRun(storage)){
+                ::operator delete(ptr);
+                return;
+            }
+            push(sizeClass, ptr);
+        }
+        
+        bool canReclaim() const override { return false; }
+        
+        //largest request served from the pool, rounded up to a power of two
+        inline void setMaxClassObjects(size_t count){ mNumClasses = std::min(classFor(std::max<size_t>(count, 1)) + 1, MAX_CLASSES); }
+        inline size_t getMaxClassObjects() const { return size_t(1) << (mNumClasses - 1); }
+        
+        inline size_t getNumHeapFallbacks() const { return mHeapFallbacks; }
+        inline size_t getNumPooledAllocations() const { return mPooledAllocations; }
+        
+    private:
+        
+        static size_t classFor(size_t count){
+            size_t sizeClass = 0;
+            while((size_t(1) << sizeClass) < count){
+                ++sizeClass;
+            }
+            return sizeClass;
+        }
+        
+        //number of contiguous indices available before a chunk would cross into the next block
+        static size_t objectsPerRun(const IMemoryStorage& storage){
+            return storage.getType() == BLOCK_LIST_STORAGE ? storage.getStorageSize() / storage.objectSize() : storage.maxSize();
+        }
+        
+        void push(size_t sizeClass, void* ptr){
+            *reinterpret_cast<void**>(ptr) = mFreeLists[sizeClass];
+            mFreeLists[sizeClass] = ptr;
+        }
+        
+        void* carve(size_t sizeClass, IMemoryStorage& storage){
+            auto objects = size_t(1) << sizeClass;
+            auto run = objectsPerRun(storage);
+            auto offset = mLast % run;
+            if(offset + objects > run){
+                //split the rest of this block into the largest classes that fit
+                auto remaining = run - offset;
+                for(size_t c = std::min(mNumClasses, classFor(remaining) + 1); c-- > 0 && remaining;){
+                    auto chunk = size_t(1) << c;
+                    while(remaining >= chunk){
+                        push(c, storage[mLast]);
+                        mLast += chunk;
+                        remaining -= chunk;
+                    }
+                }
+            }
+            auto ret = storage[mLast];
+            //make sure the whole chunk exists before handing it out
+            storage[mLast + objects - 1];
+            mLast += objects;
+            return ret;
+        }
+        
+        std::array<void*, MAX_CLASSES> mFreeLists{};
+        std::unordered_set<void*> mHeapChunks;
+        size_t mNumClasses{9}; //up to 256 objects
+        size_t mLast{0};
+        size_t mHeapFallbacks{0};
+        size_t mPooledAllocations{0};
+    };
+
+    //Linear arena for transient data. Allocations bump through the storage and are never freed
+    //individually, except that freeing the most recent allocation rewinds the top like a stack.
+    //Everything is released at once by reset(). Runs never straddle a block, requests larger than
+    //a block go to the heap and are freed on reset. Not thread-safe.
+    //In debug builds released memory is filled with POISON so use after reset shows up quickly.
+    class FrameArena final : public IAllocationStrategy {
+    public:
+        
+        static constexpr unsigned char POISON = 0xCD;
+        
+        AllocationStrategyType getType() const override { return FRAME_ARENA; }
+        
+        void initialize() override {
+            mTop = 0;
+            mCursor = nullptr;
+            mRemaining = 0;
+        }
+        
+        ~FrameArena(){
+            releaseHeapChunks();
+        }
+        
+        void* allocate( size_t count, IMemoryStorage& storage ) override {
+            if(count <= mRemaining){
+                auto ret = mCursor;
+                mCursor += count * mObjectSize;
+                mRemaining -= count;
+                mTop += count;
+                mPeak = std::max(mPeak, mTop);
+                return ret;
+            }
+            if(!mRun){
+                mRun = objectsPerRun(storage);
+                mObjectSize = storage.objectSize();
+            }
+            if(count > mRun){
+                return heapChunk(count);
+            }
+            //skip the tail of the current block, the storage only gets touched once per block
+            auto next = mCursor ? mTop + mRemaining : mTop;
+            try{
+                mCursor = static_cast<char*>(storage[next]);
+            }catch(const std::bad_alloc&){
+                //fixed storage is full for this frame
+                return heapChunk(count);
+            }
+            mTop = next;
+            mRemaining = mRun;
+            return allocate(count, storage);
+        }
+        
+        void deallocate(void* ptr, size_t count, IMemoryStorage& storage) override {
+            //only the most recent allocation can be given back, everything else waits for reset
+            auto bytes = count * mObjectSize;
+            if(count + mRemaining <= mRun && mCursor && ptr == mCursor - bytes){
+                mCursor -= bytes;
+                mRemaining += count;
+                mTop -= count;
+#if !defined(NDEBUG)
+                std::memset(ptr, POISON, bytes);
+#endif
+            }
+        }
+        
+        void reset( IMemoryStorage& storage ) override {
+#if !defined(NDEBUG)
+            for(size_t start = 0; mRun && start < mTop; start += mRun){
+                std::memset(storage[start], POISON, std::min(mRun, mTop - start) * mObjectSize);
+            }
+#endif
+            releaseHeapChunks();
+            mTop = 0;
+            mCursor = nullptr;
+            mRemaining = 0;
+            ++mResetCount;
+        }
+        
+        bool canReclaim() const override { return true; }
+        
+        //objects handed out since the last reset, including skipped block tails
+        inline size_t getNumUsedObjects() const { return mTop; }
+        inline size_t getPeakUsedObjects() const { return mPeak; }
+        inline size_t getNumHeapChunks() const { return mHeapChunks.size(); }
+        //bumped on every reset, handy for asserting a pointer's frame is still current
+        inline size_t getResetCount() const { return mResetCount; }
+        
+    private:
+        
+        static size_t objectsPerRun(const IMemoryStorage& storage){
+            return storage.getType() == BLOCK_LIST_STORAGE ? storage.getStorageSize() / storage.objectSize() : storage.maxSize();
+        }
+        
+        void* heapChunk(size_t count){
+            auto ret = ::operator new(count * mObjectSize, ::std::nothrow);
+            if(ret)
+                mHeapChunks.push_back(ret);
+            return ret;
+        }
+        
+        void releaseHeapChunks(){
+            for(auto ptr : mHeapChunks){
+                ::operator delete(ptr);
+            }
+            mHeapChunks.clear();
+        }
+        
+        std::vector<void*> mHeapChunks;
+        char* mCursor{nullptr};
+        size_t mRemaining{0};   //objects left in the current block
+        size_t mRun{0};         //objects per block
+        size_t mObjectSize{0};
+        size_t mTop{0};
+        size_t mPeak{0};
+        size_t mResetCount{0};
+    };
+    
 }//end namespace mediasystem
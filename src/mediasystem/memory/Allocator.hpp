@@ -36,10 +36,7 @@ namespace mediasystem {
         
         explicit ms_Allocator(AllocationManager* manager = nullptr, const AllocationPolicyFormat& fmt = AllocationPolicyFormat()):mManager(manager){
             if(mManager){
-                auto policy = mManager->getPolicy<T>();
-                if(!policy){
-                    mManager->setPolicy<T>(fmt);
-                }
+                mPolicy = mManager->trySetPolicy<T>(fmt);
             }
         }
         
@@ -57,7 +54,7 @@ namespace mediasystem {
                 throw std::bad_alloc();
             
             if(auto mypolicy = mManager->getPolicy<T>()){
-                return;
+                mPolicy = mypolicy;
             }else{
                 if(auto policy = mManager->getPolicy<U>()){
                     std::stringstream fmtStream;
@@ -66,32 +63,31 @@ namespace mediasystem {
                     << "from type U [size: " << sizeof(U) <<" id: " << typeid(U).name() << "]\n"
                     << "with"
                     << fmtStream.str();
-                    mManager->trySetPolicy<T>(policy->getFormat());
+                    mPolicy = mManager->trySetPolicy<T>(policy->getFormat());
                 }else{
                     ofLogVerbose("Memory") << "don't have policies for U [id: " << typeid(U).name() << "]\n"
                     << "or T [id: " << typeid(T).name() << "]\n"
                     << "defaulting both to heap";
-                    mManager->setPolicy<T>(); //default
-                    mManager->setPolicy<U>(); //default
+                    mPolicy = mManager->trySetPolicy<T>(); //default
+                    mManager->trySetPolicy<U>(); //default
                 }
             }
             
         }
         
+        //the policy is resolved once at construction, replaced policies are kept alive by the manager
         pointer allocate(size_type count = 1, const_pointer hint = 0)
         {
-            if(!mManager)
+            if(!mPolicy)
                 throw std::bad_alloc();
-            auto policy = mManager->getPolicy<T>();
-            return static_cast<pointer>(policy->allocate(count));
+            return static_cast<pointer>(mPolicy->allocate(count));
         }
         
         void deallocate(pointer ptr, size_type count = 1)
         {
-            if(!mManager)
+            if(!mPolicy)
                 throw std::bad_alloc();
-            auto policy = mManager->getPolicy<T>();
-            policy->deallocate(ptr, count);
+            mPolicy->deallocate(ptr, count);
         }
         
         //These don't work on all platforms
@@ -110,6 +106,66 @@ namespace mediasystem {
         }
         
         AllocationManager* mManager;
+        IAllocationPolicy* mPolicy{nullptr};
+    };
+    
+    //Allocator bound to a StaticAllocationPolicy, e.g.
+    //StaticAllocator<T, StaticAllocationPolicy<SlabPool, BlockListStorage>>
+    //Allocation is a direct call into the policy, no lookup and no virtual dispatch on the fast path.
+    //Rebinding creates a policy of the same type for the new type with the same format.
+    template<typename T, typename Policy>
+    class StaticAllocator {
+    public:
+        ALLOCATOR_TRAITS(T);
+        
+        explicit StaticAllocator(AllocationManager* manager, const AllocationPolicyFormat& fmt = AllocationPolicyFormat()):
+            mManager(manager),
+            mPolicy(manager ? manager->trySetStaticPolicy<T, Policy>(fmt) : nullptr)
+        {}
+        
+        template<typename U>
+        struct rebind
+        {
+            typedef StaticAllocator<U, Policy> other;
+        };
+        
+        template<typename U>
+        StaticAllocator(StaticAllocator<U, Policy> const& other) :
+            mManager(other.mManager)
+        {
+            if(!mManager || !other.mPolicy)
+                throw std::bad_alloc();
+            mPolicy = mManager->trySetStaticPolicy<T, Policy>(other.mPolicy->getFormat());
+        }
+        
+        pointer allocate(size_type count = 1, const_pointer hint = 0)
+        {
+            return static_cast<pointer>(mPolicy->allocate(count));
+        }
+        
+        void deallocate(pointer ptr, size_type count = 1)
+        {
+            mPolicy->deallocate(ptr, count);
+        }
+        
+        template<typename...Args>
+        void construct(type* ptr, Args&&...args)
+        {
+            new(ptr) type(std::forward<Args>(args)...);
+        }
+        
+        void destroy(type* ptr)
+        {
+            ptr->~type();
+        }
+        
+        inline Policy* getPolicy() const { return mPolicy; }
+        
+        bool operator==(const StaticAllocator& other) const { return mPolicy == other.mPolicy; }
+        bool operator!=(const StaticAllocator& other) const { return mPolicy != other.mPolicy; }
+        
+        AllocationManager* mManager;
+        Policy* mPolicy{nullptr};
     };
     
 }//end namespace mediasystem
@@ -0,0 +1,262 @@
+//
+//  MappedStorage.hpp
+//  ofxMediaSystem
+//
+//  Fixed size storage mapped straight from the OS instead of ::operator new + memset.
+//  Anonymous mappings are already zeroed and only cost page faults when touched, so a large
+//  pool can be reserved up front for free. Optionally backed by huge pages, pre-faulted on a
+//  background thread and bound to a NUMA node. Every option degrades to a plain mapping
+//  when the platform or the system configuration doesn't support it.
+//
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <cassert>
+#include "ofMain.h"
+#include "Storage.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace mediasystem {
+
+    struct MappedStorageOptions {
+
+        enum Prefault {
+            PREFAULT_NONE,          //pages fault in on first touch
+            PREFAULT_SYNC,          //initialize() returns with every page resident
+            PREFAULT_BACKGROUND     //a thread faults pages in while the storage is already in use
+        };
+
+        MappedStorageOptions& hugePages(bool use = true){ useHugePages = use; return *this; }
+        MappedStorageOptions& prefault(Prefault mode){ prefaultMode = mode; return *this; }
+        MappedStorageOptions& numaNode(int node){ bindNumaNode = node; return *this; }
+
+        //tries MAP_HUGETLB first, then transparent huge pages through madvise
+        bool useHugePages{false};
+        Prefault prefaultMode{PREFAULT_NONE};
+        //-1 leaves placement to the OS, Linux only
+        int bindNumaNode{-1};
+    };
+
+    class MappedStorage final : public IMemoryStorage {
+    public:
+
+        static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        MappedStorage(size_t objectSize, size_t size, const MappedStorageOptions& options = MappedStorageOptions()) :
+            mOptions(options),
+            mRequestedSize(size),
+            mObjectSize(((objectSize + sizeof(void *)-1) / sizeof(void *)) * sizeof(void *)),
+            mBlockSize(mObjectSize * (size/mObjectSize))
+        {
+            assert(objectSize <= size);
+            assert(mObjectSize <= mBlockSize);
+        }
+
+        ~MappedStorage() {
+            unmap();
+        }
+
+        void initialize() override {
+            unmap();
+            map();
+            if(mObjects){
+                bindNuma();
+                mPrefaultStop = false;
+                switch(mOptions.prefaultMode){
+                    case MappedStorageOptions::PREFAULT_SYNC:{
+                        prefault(mObjects, mBlockSize, mPrefaultStop);
+                    }break;
+                    case MappedStorageOptions::PREFAULT_BACKGROUND:{
+                        mPrefaultThread = std::thread([this]{ prefault(mObjects, mBlockSize, mPrefaultStop); });
+                    }break;
+                    default: break;
+                }
+            }
+        }
+
+        void* operator[](size_t index) override {
+            if(!mObjects || index >= (mBlockSize / mObjectSize)) throw std::bad_alloc();
+            return reinterpret_cast<void*>(mObjects + (index * mObjectSize));
+        }
+
+        //blocks until a background prefault has finished
+        void waitForPrefault(){
+            if(mPrefaultThread.joinable())
+                mPrefaultThread.join();
+        }
+
+        inline void* data() const { return mObjects; }
+        inline bool contains(const void* ptr) const {
+            auto p = reinterpret_cast<const char*>(ptr);
+            return p >= mObjects && p < mObjects + mBlockSize;
+        }
+        
+        size_t indexOf(const void* ptr) const override {
+            if(!contains(ptr))
+                return npos;
+            return static_cast<size_t>(reinterpret_cast<const char*>(ptr) - mObjects) / mObjectSize;
+        }
+
+        //what the system actually granted, the options are only requests
+        inline bool isUsingHugePages() const { return mHugeTlb; }
+        inline bool isUsingTransparentHugePages() const { return mTransparentHugePages; }
+        inline bool isNumaBound() const { return mNumaBound; }
+        inline const MappedStorageOptions& getOptions() const { return mOptions; }
+
+        size_t objectSize() const override { return mObjectSize; };
+        size_t getRequestedStorageSize() const override { return mRequestedSize; }
+        size_t getStorageSize() const override { return mBlockSize; }
+        size_t getStorageCount() const override { return 1; }
+        size_t getStorageInitialCount() const override { return 1; }
+        bool canGrow() const override { return false; }
+        size_t capacity() const override { return mBlockSize / mObjectSize; }
+        size_t maxSize() const override { return mBlockSize / mObjectSize; }
+        AllocationStorageType getType() const override { return MAPPED_STORAGE; }
+
+    private:
+
+        static size_t pageSize(){
+#if defined(_WIN32)
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return info.dwPageSize;
+#else
+            return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+        }
+
+        static size_t roundUp(size_t size, size_t alignment){
+            return ((size + alignment - 1) / alignment) * alignment;
+        }
+
+        void map(){
+            mHugeTlb = false;
+            mTransparentHugePages = false;
+#if defined(_WIN32)
+            mMappedSize = roundUp(mBlockSize, pageSize());
+            mMapping = VirtualAlloc(nullptr, mMappedSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+            mObjects = reinterpret_cast<char*>(mMapping);
+            if(!mMapping){
+                ofLogError("Memory") << "MappedStorage failed to map " << mMappedSize << " bytes";
+            }
+#else
+#if defined(MAP_HUGETLB)
+            if(mOptions.useHugePages){
+                mMappedSize = roundUp(mBlockSize, HUGE_PAGE_SIZE);
+                auto mapping = mmap(nullptr, mMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if(mapping != MAP_FAILED){
+                    mMapping = mapping;
+                    mObjects = reinterpret_cast<char*>(mapping);
+                    mHugeTlb = true;
+                    return;
+                }
+            }
+#endif
+            //over map so transparent huge pages can line up with the region
+            auto alignment = mOptions.useHugePages ? HUGE_PAGE_SIZE : pageSize();
+            mMappedSize = roundUp(mBlockSize, pageSize()) + (alignment - pageSize());
+            auto mapping = mmap(nullptr, mMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(mapping == MAP_FAILED){
+                mMapping = nullptr;
+                mObjects = nullptr;
+                ofLogError("Memory") << "MappedStorage failed to map " << mMappedSize << " bytes";
+                return;
+            }
+            mMapping = mapping;
+            mObjects = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(mapping), alignment));
+#if defined(MADV_HUGEPAGE)
+            if(mOptions.useHugePages){
+                mTransparentHugePages = madvise(mObjects, roundUp(mBlockSize, pageSize()), MADV_HUGEPAGE) == 0;
+            }
+#endif
+#endif
+        }
+
+        void unmap(){
+            mPrefaultStop = true;
+            waitForPrefault();
+            if(mMapping){
+#if defined(_WIN32)
+                VirtualFree(mMapping, 0, MEM_RELEASE);
+#else
+                munmap(mMapping, mMappedSize);
+#endif
+            }
+            mMapping = nullptr;
+            mObjects = nullptr;
+            mNumaBound = false;
+        }
+
+        //raw syscall so there is no dependency on libnuma, must run before the pages are touched
+        void bindNuma(){
+#if defined(__linux__) && defined(SYS_mbind)
+            if(mOptions.bindNumaNode < 0)
+                return;
+            static const int MS_MPOL_BIND = 2;
+            static const size_t MASK_BITS = sizeof(unsigned long) * 8;
+            auto node = static_cast<size_t>(mOptions.bindNumaNode);
+            std::vector<unsigned long> mask(node / MASK_BITS + 1, 0);
+            mask[node / MASK_BITS] = 1ul << (node % MASK_BITS);
+            auto length = roundUp(mBlockSize, pageSize());
+            mNumaBound = syscall(SYS_mbind, mObjects, length, MS_MPOL_BIND, mask.data(), mask.size() * MASK_BITS + 1, 0) == 0;
+            if(!mNumaBound){
+                ofLogWarning("Memory") << "MappedStorage could not bind to NUMA node " << mOptions.bindNumaNode;
+            }
+#endif
+        }
+
+        //faults pages in without changing their contents, so it is safe while objects are being written
+        static void prefault(char* begin, size_t size, const std::atomic_bool& stop){
+            auto page = pageSize();
+#if defined(__linux__)
+            //MADV_POPULATE_WRITE, linux 5.14
+            static const int MS_MADV_POPULATE_WRITE = 23;
+            static const size_t CHUNK = 64 * page;
+            bool populated = true;
+            for(size_t offset = 0; offset < size && !stop; offset += CHUNK){
+                if(madvise(begin + offset, std::min(CHUNK, roundUp(size - offset, page)), MS_MADV_POPULATE_WRITE) != 0){
+                    populated = false;
+                    break;
+                }
+            }
+            if(populated)
+                return;
+#endif
+            //atomic add of zero forces a write fault and can't lose a concurrent store
+            for(size_t offset = 0; offset < size && !stop; offset += page){
+#if defined(_MSC_VER)
+                _InterlockedOr8(begin + offset, 0);
+#else
+                __atomic_fetch_add(begin + offset, 0, __ATOMIC_RELAXED);
+#endif
+            }
+        }
+
+        const MappedStorageOptions mOptions;
+        const size_t mRequestedSize{0};
+        const size_t mObjectSize{0};
+        const size_t mBlockSize{0};
+        void* mMapping{nullptr};
+        size_t mMappedSize{0};
+        char* mObjects{nullptr};
+        bool mHugeTlb{false};
+        bool mTransparentHugePages{false};
+        bool mNumaBound{false};
+        std::atomic_bool mPrefaultStop{false};
+        std::thread mPrefaultThread;
+    };
+
+}//end namespace mediasystem
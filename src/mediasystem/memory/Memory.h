@@ -13,4 +13,6 @@
 #include "AllocationManager.hpp"
 #include "AllocationStrategies.hpp"
 #include "AllocationMiddleware.hpp"
+#include "AllocationReport.hpp"
 #include "Storage.hpp"
+#include "MappedStorage.hpp"
@@ -7,12 +7,19 @@
 
 #pragma once
 
-#include "Allocator.hpp"
-
+//must come before the policies are included or the middleware hooks compile out
 #if !defined(MS_ALLOW_ALLOCATION_MIDDLEWARE)
 #define MS_ALLOW_ALLOCATION_MIDDLEWARE
 #endif
 
+//LEAK_TRACKER records every live allocation, so it is only compiled into debug builds by default.
+//Define it project wide to keep leak tracking in release.
+#if !defined(MS_ALLOW_LEAK_TRACKING) && !defined(NDEBUG)
+#define MS_ALLOW_LEAK_TRACKING
+#endif
+
+#include "Allocator.hpp"
+
 namespace mediasystem {
     
     template<typename T>
@@ -10,13 +10,17 @@
 #include <cstring>
 #include <stdint.h>
 #include <memory>
+#include <vector>
+#include <map>
+#include <cassert>
 
 namespace mediasystem {
     
-    enum AllocationStorageType { FIXED_SIZE_STORAGE, BLOCK_LIST_STORAGE, NO_STORAGE };
+    enum AllocationStorageType { FIXED_SIZE_STORAGE, BLOCK_LIST_STORAGE, NO_STORAGE, MAPPED_STORAGE };
     
     class IMemoryStorage {
     public:
+        virtual ~IMemoryStorage() = default;
         virtual void initialize() = 0;
         virtual void* operator[](size_t index) = 0;
         virtual AllocationStorageType getType() const = 0;
@@ -28,9 +32,13 @@ namespace mediasystem {
         virtual size_t getStorageSize() const = 0;
         virtual size_t getStorageCount() const = 0;
         virtual size_t getStorageInitialCount() const = 0;
+        //index that operator[] would map to ptr, npos if ptr isn't in this storage
+        virtual size_t indexOf(const void* ptr) const = 0;
+        
+        static constexpr size_t npos = static_cast<size_t>(-1);
     };
 
-    class FixedSizeStorage : public IMemoryStorage {
+    class FixedSizeStorage final : public IMemoryStorage {
     public:
     
         FixedSizeStorage(size_t objectSize, size_t size) :
@@ -59,6 +67,19 @@ namespace mediasystem {
             return reinterpret_cast<void*>(head + (index * mObjectSize));
         }
         
+        inline void* data() const { return mObjects; }
+        inline bool contains(const void* ptr) const {
+            auto head = reinterpret_cast<const char*>(mObjects);
+            auto p = reinterpret_cast<const char*>(ptr);
+            return p >= head && p < head + mBlockSize;
+        }
+        
+        size_t indexOf(const void* ptr) const override {
+            if(!contains(ptr))
+                return npos;
+            return static_cast<size_t>(reinterpret_cast<const char*>(ptr) - reinterpret_cast<const char*>(mObjects)) / mObjectSize;
+        }
+        
         size_t objectSize() const override { return mObjectSize; };
         size_t getRequestedStorageSize() const override { return mRequestedSize; }
         size_t getStorageSize() const override { return mBlockSize; }
@@ -76,7 +97,9 @@ namespace mediasystem {
         const size_t mBlockSize{0};
     };
 
-    class BlockListStorage : public IMemoryStorage {
+    //Blocks live at stable indices, index -> block is a vector lookup. A freed block keeps its slot
+    //so indices handed out earlier stay valid, it is recreated the next time one of its objects is requested.
+    class BlockListStorage final : public IMemoryStorage {
     public:
         
         BlockListStorage(size_t objectSize, size_t block_size, size_t num_blocks = 1) :
@@ -91,54 +114,85 @@ namespace mediasystem {
         }
         
         void initialize() override {
-            mBlocks = std::list<FixedSizeStorage>(mInitalBlockCount, FixedSizeStorage(mObjectSize, mBlockSize));
-            for(auto & block: mBlocks){
-                block.initialize();
+            mBlocks.clear();
+            mBlockLookup.clear();
+            mLiveBlocks = 0;
+            for(size_t i = 0; i < mInitalBlockCount; i++){
+                ensureBlock(i);
             }
         }
         
         void* operator[](size_t index) override {
-            size_t block = floor(index / (mBlockSize / mObjectSize));
-            if(block == mBlocks.size()){
-                std::cout << "exceeded block count, create a new one" << std::endl;
-                mBlocks.emplace_back(mObjectSize, mBlockSize);
-                mBlocks.back().initialize();
-            }else if(block > mBlocks.size()){
-                for(size_t i = 0; i < (block - mBlocks.size()); i++ ){
-                    std::cout << "catching up..." << std::endl;
-                    mBlocks.emplace_back(mObjectSize, mBlockSize);
-                    mBlocks.back().initialize();
-                }
+            auto perBlock = objectsPerBlock();
+            auto& block = ensureBlock(index / perBlock);
+            return block[index % perBlock];
+        }
+        
+        //creates the block at index if it was never allocated or has been freed
+        FixedSizeStorage& ensureBlock(size_t index){
+            if(index >= mBlocks.size()){
+                mBlocks.resize(index + 1);
             }
-            auto it = mBlocks.begin();
-            std::advance(it, block);
-            return (*it)[index % (mBlockSize / mObjectSize)];
+            auto& block = mBlocks[index];
+            if(!block){
+                block.reset(new FixedSizeStorage(mObjectSize, mBlockSize));
+                block->initialize();
+                mBlockLookup[reinterpret_cast<const char*>(block->data())] = index;
+                ++mLiveBlocks;
+            }
+            return *block;
         }
         
+        //returns the block's memory, any objects still in it are lost
         void freeBlock(size_t index){
-            auto it = mBlocks.begin();
-            std::advance(it,index);
-            if(it != mBlocks.end()){
-                mBlocks.erase(it);
+            if(index < mBlocks.size() && mBlocks[index]){
+                mBlockLookup.erase(reinterpret_cast<const char*>(mBlocks[index]->data()));
+                mBlocks[index].reset();
+                --mLiveBlocks;
+            }
+        }
+        
+        inline bool isBlockAllocated(size_t index) const { return index < mBlocks.size() && mBlocks[index]; }
+        
+        //index of the live block holding ptr, or npos
+        size_t getBlockIndex(const void* ptr) const {
+            auto p = reinterpret_cast<const char*>(ptr);
+            auto found = mBlockLookup.upper_bound(p);
+            if(found == mBlockLookup.begin()){
+                return npos;
             }
+            --found;
+            return p < found->first + mBlockSize ? found->second : npos;
+        }
+        
+        size_t indexOf(const void* ptr) const override {
+            auto block = getBlockIndex(ptr);
+            if(block == npos)
+                return npos;
+            return block * objectsPerBlock() + mBlocks[block]->indexOf(ptr);
         }
         
+        inline size_t objectsPerBlock() const { return mBlockSize / mObjectSize; }
+        inline size_t getNumBlockSlots() const { return mBlocks.size(); }
+        
         size_t objectSize() const override { return mObjectSize; };
         size_t getRequestedStorageSize() const override { return mRequestedSize; }
         size_t getStorageSize() const override { return mBlockSize; }
-        size_t getStorageCount() const override { return mBlocks.size(); }
+        size_t getStorageCount() const override { return mLiveBlocks; }
         size_t getStorageInitialCount() const override { return mInitalBlockCount; }
         AllocationStorageType getType() const override { return BLOCK_LIST_STORAGE; }
         bool canGrow() const override { return true; }
-        size_t capacity() const override { return mBlocks.size() * (mBlockSize / mObjectSize); }
-        size_t maxSize() const override { return mBlocks.size() * mBlockSize; }
+        size_t capacity() const override { return mLiveBlocks * objectsPerBlock(); }
+        size_t maxSize() const override { return mLiveBlocks * mBlockSize; }
         
     private:
         const size_t mRequestedSize{0};
         const size_t mObjectSize{0};
         const size_t mBlockSize{0};
         const size_t mInitalBlockCount{0};
-        std::list<FixedSizeStorage> mBlocks;
+        size_t mLiveBlocks{0};
+        std::vector<std::unique_ptr<FixedSizeStorage>> mBlocks;
+        std::map<const char*, size_t> mBlockLookup;
     };
     
 }//end namespace mediasystem
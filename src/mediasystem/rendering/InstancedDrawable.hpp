@@ -138,13 +138,16 @@ namespace mediasystem {
         }
         
         void draw(){
-            auto iter = mInstances.iter();
             if(mInstances.size() > mLocalBuffer.size()){
                 resize(mInstances.size());
             }
-            auto dataPtr = mLocalBuffer.begin();
-            while(auto it = iter.next()){
-                callPopulate(*it, *dataPtr++, gen_seq<sizeof...(GPUTypes)>(), BoolType<(is_greater<sizeof...(GPUTypes),1>())>());
+            auto populate = [this](InstanceType& instance, size_t index){
+                callPopulate(instance, mLocalBuffer[index], gen_seq<sizeof...(GPUTypes)>(), BoolType<(is_greater<sizeof...(GPUTypes),1>())>());
+            };
+            if(mInstances.size() >= mParallelPopulateThreshold){
+                mInstances.parallelForEach(populate);
+            }else{
+                mInstances.forEach(populate);
             }
             mGpuBuffer.updateData(sizeof(GPURep) * mInstances.size(), mLocalBuffer.data());
             
@@ -155,6 +158,11 @@ namespace mediasystem {
             mShader.end();
         }
         
+        //Fills the instance buffer across the scene's JobSystem once there are at least this many instances.
+        //Off by default, only turn it on when InstanceType::populate is safe to call concurrently.
+        void setParallelPopulateThreshold(size_t numInstances){ mParallelPopulateThreshold = numInstances; }
+        void disableParallelPopulate(){ mParallelPopulateThreshold = std::numeric_limits<size_t>::max(); }
+        
         UniformData& getUniforms(){ return mUniformData; }
         ofShader& getShader(){ return mShader; }
         ofVboMesh& getMesh(){ return mMesh; }
@@ -184,6 +192,7 @@ namespace mediasystem {
         ofShader mShader;
         ofVboMesh mMesh;
         UniformData mUniformData;
+        size_t mParallelPopulateThreshold{std::numeric_limits<size_t>::max()};
     };
     
 }//end namespace mediasystem
@@ -0,0 +1,547 @@
+//
+//  JobSystem.cpp
+//  ofxMediaSystem
+//
+
+#include "JobSystem.h"
+#include <array>
+#include <algorithm>
+#include <new>
+#include <exception>
+#include "Log.h"
+
+namespace mediasystem {
+
+    namespace detail {
+
+        struct Continuation {
+            Job* job;
+            Continuation* next;
+        };
+
+        //swapped in as the continuation list once a job has run, nothing can be chained after that
+        static Continuation sFinished{nullptr, nullptr};
+
+        struct Job {
+            JobSystem::JobFn fn;
+            //one for the handle returned by schedule, one released after the job has run,
+            //plus one for every dependency still holding it as a continuation
+            std::atomic<uint32_t> refs{2};
+            //dependencies that haven't finished, plus one held until scheduling is complete
+            std::atomic<uint32_t> unfinished{1};
+            bool mainThread{false};
+            //lock free stack of jobs waiting on this one, sFinished once it has run
+            std::atomic<Continuation*> continuations{nullptr};
+        };
+
+        //Job memory is recycled on the thread that released it, jobs are created and destroyed at a high
+        //rate and the allocator is much slower when memory is freed on another thread than it came from.
+        //The list is plain thread locals so jobs released during thread or static teardown stay safe.
+        struct FreeJob {
+            FreeJob* next;
+        };
+
+        static const size_t MAX_CACHED_JOBS = 1024;
+        thread_local FreeJob* tFreeJobs = nullptr;
+        thread_local size_t tNumFreeJobs = 0;
+        thread_local bool tJobCacheClosed = false;
+
+        struct JobCacheCleanup {
+            ~JobCacheCleanup(){
+                tJobCacheClosed = true;
+                while(tFreeJobs){
+                    auto next = tFreeJobs->next;
+                    ::operator delete(tFreeJobs);
+                    tFreeJobs = next;
+                }
+                tNumFreeJobs = 0;
+            }
+        };
+        thread_local JobCacheCleanup tJobCacheCleanup;
+
+        inline Job* createJob(){
+            if(!tFreeJobs)
+                return new Job();
+            auto memory = tFreeJobs;
+            tFreeJobs = memory->next;
+            --tNumFreeJobs;
+            return new (memory) Job();
+        }
+
+        inline void destroyJob(Job* job){
+            job->~Job();
+            if(tJobCacheClosed || tNumFreeJobs >= MAX_CACHED_JOBS){
+                ::operator delete(job);
+                return;
+            }
+            //registers the cleanup for this thread
+            (void)&tJobCacheCleanup;
+            tFreeJobs = new (job) FreeJob{tFreeJobs};
+            ++tNumFreeJobs;
+        }
+
+        inline void retainJob(Job* job){ job->refs.fetch_add(1, std::memory_order_relaxed); }
+        inline void releaseJob(Job* job){
+            if(job->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                destroyJob(job);
+        }
+
+        //Bounded Chase-Lev deque. The owner pushes and pops at the bottom, thieves take from the top.
+        //push fails when full and the caller falls back to the shared queue.
+        class WorkStealingDeque {
+        public:
+
+            static const int64_t CAPACITY = 4096;
+
+            bool push(Job* job){
+                auto bottom = mBottom.load(std::memory_order_relaxed);
+                auto top = mTop.load(std::memory_order_acquire);
+                if(bottom - top >= CAPACITY)
+                    return false;
+                mItems[bottom & MASK].store(job, std::memory_order_relaxed);
+                //publishes the item to thieves, they read bottom with acquire
+                mBottom.store(bottom + 1, std::memory_order_release);
+                return true;
+            }
+
+            Job* pop(){
+                //top only grows, so a stale top that already covers bottom means the deque is empty
+                if(mBottom.load(std::memory_order_relaxed) <= mTop.load(std::memory_order_relaxed))
+                    return nullptr;
+                auto bottom = mBottom.load(std::memory_order_relaxed) - 1;
+                mBottom.store(bottom, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto top = mTop.load(std::memory_order_relaxed);
+                if(top > bottom){
+                    mBottom.store(bottom + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                auto job = mItems[bottom & MASK].load(std::memory_order_relaxed);
+                if(top == bottom){
+                    //last item, race the thieves for it
+                    if(!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                        job = nullptr;
+                    mBottom.store(bottom + 1, std::memory_order_relaxed);
+                }
+                return job;
+            }
+
+            Job* steal(){
+                auto top = mTop.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto bottom = mBottom.load(std::memory_order_acquire);
+                if(top >= bottom)
+                    return nullptr;
+                auto job = mItems[top & MASK].load(std::memory_order_relaxed);
+                if(!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    return nullptr;
+                return job;
+            }
+
+        private:
+            static const int64_t MASK = CAPACITY - 1;
+            static_assert((CAPACITY & MASK) == 0, "WorkStealingDeque capacity must be a power of two");
+
+            alignas(64) std::atomic<int64_t> mTop{0};
+            alignas(64) std::atomic<int64_t> mBottom{0};
+            alignas(64) std::array<std::atomic<Job*>, CAPACITY> mItems{};
+        };
+
+    }//end namespace detail
+
+    namespace {
+        thread_local const JobSystem* tJobSystem = nullptr;
+        thread_local size_t tWorkerIndex = 0;
+    }
+
+    struct JobSystem::Worker {
+        detail::WorkStealingDeque deque;
+        std::thread thread;
+    };
+
+    /////JobHandle
+
+    JobHandle::JobHandle(const JobHandle& other):mJob(other.mJob)
+    {
+        if(mJob)
+            detail::retainJob(mJob);
+    }
+
+    JobHandle::JobHandle(JobHandle&& other) noexcept :mJob(other.mJob)
+    {
+        other.mJob = nullptr;
+    }
+
+    JobHandle& JobHandle::operator=(const JobHandle& other)
+    {
+        if(other.mJob)
+            detail::retainJob(other.mJob);
+        reset();
+        mJob = other.mJob;
+        return *this;
+    }
+
+    JobHandle& JobHandle::operator=(JobHandle&& other) noexcept
+    {
+        if(this != &other){
+            reset();
+            mJob = other.mJob;
+            other.mJob = nullptr;
+        }
+        return *this;
+    }
+
+    JobHandle::~JobHandle()
+    {
+        reset();
+    }
+
+    bool JobHandle::isDone() const
+    {
+        return !mJob || mJob->continuations.load(std::memory_order_acquire) == &detail::sFinished;
+    }
+
+    void JobHandle::reset()
+    {
+        if(mJob){
+            detail::releaseJob(mJob);
+            mJob = nullptr;
+        }
+    }
+
+    /////JobSystem
+
+    JobSystem::JobSystem(size_t numWorkers):
+        mMainThreadId(std::this_thread::get_id())
+    {
+        if(numWorkers == 0){
+            auto hardware = std::thread::hardware_concurrency();
+            numWorkers = std::max<size_t>(hardware > 1 ? hardware - 1 : 1, 1);
+        }
+        mWorkers.reserve(numWorkers);
+        for(size_t i = 0; i < numWorkers; i++){
+            mWorkers.emplace_back(new Worker());
+        }
+        //started after every deque exists so thieves never see a partial list
+        for(size_t i = 0; i < numWorkers; i++){
+            mWorkers[i]->thread = std::thread(&JobSystem::workerThread, this, i);
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mShutdown = true;
+        }
+        mSleepCondition.notify_all();
+        for(auto & worker : mWorkers){
+            if(worker->thread.joinable())
+                worker->thread.join();
+        }
+        //workers drain their queues before exiting, anything left was released by main thread jobs
+        while(runMainThreadJob() || helpOnce()){}
+    }
+
+    JobHandle JobSystem::schedule(JobFn fn)
+    {
+        return submit(std::move(fn), nullptr, 0, false);
+    }
+
+    JobHandle JobSystem::schedule(JobFn fn, std::initializer_list<JobHandle> dependencies)
+    {
+        return submit(std::move(fn), dependencies.begin(), dependencies.size(), false);
+    }
+
+    JobHandle JobSystem::schedule(JobFn fn, const std::vector<JobHandle>& dependencies)
+    {
+        return submit(std::move(fn), dependencies.data(), dependencies.size(), false);
+    }
+
+    JobHandle JobSystem::then(const JobHandle& dependency, JobFn fn)
+    {
+        return submit(std::move(fn), &dependency, 1, false);
+    }
+
+    JobHandle JobSystem::scheduleOnMainThread(JobFn fn)
+    {
+        return submit(std::move(fn), nullptr, 0, true);
+    }
+
+    JobHandle JobSystem::scheduleOnMainThread(JobFn fn, std::initializer_list<JobHandle> dependencies)
+    {
+        return submit(std::move(fn), dependencies.begin(), dependencies.size(), true);
+    }
+
+    JobHandle JobSystem::scheduleOnMainThread(JobFn fn, const std::vector<JobHandle>& dependencies)
+    {
+        return submit(std::move(fn), dependencies.data(), dependencies.size(), true);
+    }
+
+    JobHandle JobSystem::submit(JobFn&& fn, const JobHandle* dependencies, size_t numDependencies, bool mainThread)
+    {
+        auto job = detail::createJob();
+        job->fn = std::move(fn);
+        job->mainThread = mainThread;
+        job->unfinished.store(static_cast<uint32_t>(numDependencies + 1), std::memory_order_relaxed);
+
+        for(size_t i = 0; i < numDependencies; i++){
+            auto dependency = dependencies[i].mJob;
+            bool pending = false;
+            if(dependency){
+                auto head = dependency->continuations.load(std::memory_order_acquire);
+                if(head != &detail::sFinished){
+                    auto node = new detail::Continuation{job, head};
+                    detail::retainJob(job);
+                    while(head != &detail::sFinished){
+                        node->next = head;
+                        if(dependency->continuations.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_acquire)){
+                            pending = true;
+                            break;
+                        }
+                    }
+                    if(!pending){
+                        //finished while linking
+                        delete node;
+                        job->refs.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+            if(!pending)
+                job->unfinished.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        JobHandle handle(job);
+        if(numDependencies == 0 || job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            enqueue(job);
+        return handle;
+    }
+
+    void JobSystem::enqueue(detail::Job* job)
+    {
+        if(job->mainThread){
+            std::lock_guard<std::mutex> lock(mMainThreadMutex);
+            mMainThreadJobs.push_back(job);
+            return;
+        }
+
+        auto worker = currentWorkerIndex();
+        if(worker == NOT_A_WORKER || !mWorkers[worker]->deque.push(job)){
+            std::lock_guard<std::mutex> lock(mInjectedMutex);
+            mInjected.push_back(job);
+            mNumInjected.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        //pairs with the sleeping count in workerThread so a worker about to sleep can't miss this job
+        mQueued.fetch_add(1, std::memory_order_seq_cst);
+        if(mSleeping.load(std::memory_order_seq_cst) > 0){
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mSleepCondition.notify_one();
+        }
+    }
+
+    void JobSystem::run(detail::Job* job)
+    {
+        try{
+            job->fn();
+        }catch(const std::exception& e){
+            MS_LOG_ERROR(std::string("Job threw: ") + e.what());
+        }catch(...){
+            MS_LOG_ERROR("Job threw an unknown exception");
+        }
+        //drop captures now rather than when the last handle goes
+        job->fn = nullptr;
+        finish(job);
+    }
+
+    void JobSystem::finish(detail::Job* job)
+    {
+        auto node = job->continuations.exchange(&detail::sFinished, std::memory_order_acq_rel);
+        while(node){
+            auto continuation = node->job;
+            auto next = node->next;
+            delete node;
+            if(continuation->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                enqueue(continuation);
+            detail::releaseJob(continuation);
+            node = next;
+        }
+        detail::releaseJob(job);
+    }
+
+    detail::Job* JobSystem::findJob(size_t workerIndex)
+    {
+        detail::Job* job = nullptr;
+
+        if(workerIndex != NOT_A_WORKER)
+            job = mWorkers[workerIndex]->deque.pop();
+
+        if(!job && mNumInjected.load(std::memory_order_relaxed) > 0){
+            std::lock_guard<std::mutex> lock(mInjectedMutex);
+            if(!mInjected.empty()){
+                job = mInjected.front();
+                mInjected.pop_front();
+                mNumInjected.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        if(!job && !mWorkers.empty()){
+            auto count = mWorkers.size();
+            auto start = workerIndex == NOT_A_WORKER ? 0 : workerIndex + 1;
+            for(size_t i = 0; i < count && !job; i++){
+                auto victim = (start + i) % count;
+                if(victim != workerIndex)
+                    job = mWorkers[victim]->deque.steal();
+            }
+        }
+
+        if(job)
+            mQueued.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    bool JobSystem::helpOnce()
+    {
+        if(auto job = findJob(currentWorkerIndex())){
+            run(job);
+            return true;
+        }
+        return false;
+    }
+
+    bool JobSystem::runMainThreadJob()
+    {
+        detail::Job* job = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mMainThreadMutex);
+            if(mMainThreadJobs.empty())
+                return false;
+            job = mMainThreadJobs.front();
+            mMainThreadJobs.pop_front();
+        }
+        run(job);
+        return true;
+    }
+
+    size_t JobSystem::processMainThreadJobs()
+    {
+        std::deque<detail::Job*> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mMainThreadMutex);
+            jobs.swap(mMainThreadJobs);
+        }
+        for(auto job : jobs){
+            run(job);
+        }
+        return jobs.size();
+    }
+
+    size_t JobSystem::getNumMainThreadJobs() const
+    {
+        std::lock_guard<std::mutex> lock(mMainThreadMutex);
+        return mMainThreadJobs.size();
+    }
+
+    void JobSystem::wait(const JobHandle& job)
+    {
+        auto mainThread = isMainThread();
+        while(!job.isDone()){
+            if(mainThread && runMainThreadJob())
+                continue;
+            if(!helpOnce())
+                std::this_thread::yield();
+        }
+    }
+
+    void JobSystem::wait(const std::vector<JobHandle>& jobs)
+    {
+        for(auto & job : jobs){
+            wait(job);
+        }
+    }
+
+    void JobSystem::parallelFor(size_t count, const RangeFn& fn, size_t minBatchSize)
+    {
+        if(count == 0)
+            return;
+
+        //a few batches per thread so uneven work still balances
+        static const size_t BATCHES_PER_THREAD = 4;
+        minBatchSize = std::max<size_t>(minBatchSize, 1);
+        auto maxBatches = (count + minBatchSize - 1) / minBatchSize;
+        auto numBatches = std::min(maxBatches, (mWorkers.size() + 1) * BATCHES_PER_THREAD);
+        if(numBatches <= 1){
+            fn(0, count);
+            return;
+        }
+
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        auto runBatch = [&](size_t batch){
+            try{
+                fn(batch * count / numBatches, (batch + 1) * count / numBatches);
+            }catch(...){
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if(!error)
+                    error = std::current_exception();
+            }
+        };
+
+        //everything captured by reference outlives the jobs, this doesn't return before they finish
+        std::vector<JobHandle> batches;
+        batches.reserve(numBatches - 1);
+        for(size_t batch = 1; batch < numBatches; batch++){
+            batches.push_back(schedule([&runBatch, batch]{ runBatch(batch); }));
+        }
+        runBatch(0);
+        wait(batches);
+
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+    bool JobSystem::isWorkerThread() const
+    {
+        return tJobSystem == this;
+    }
+
+    size_t JobSystem::currentWorkerIndex() const
+    {
+        return tJobSystem == this ? tWorkerIndex : NOT_A_WORKER;
+    }
+
+    //queued jobs are still run on shutdown so anything waiting on them is released
+    void JobSystem::workerThread(size_t index)
+    {
+        tJobSystem = this;
+        tWorkerIndex = index;
+
+        //idle rounds before sleeping, waking a worker costs far more than a short job
+        static const int SPIN_ROUNDS = 64;
+        int idle = 0;
+        while(true){
+            if(auto job = findJob(index)){
+                run(job);
+                idle = 0;
+                continue;
+            }
+            if(++idle < SPIN_ROUNDS && !mShutdown.load(std::memory_order_relaxed)){
+                std::this_thread::yield();
+                continue;
+            }
+            idle = 0;
+
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            mSleeping.fetch_add(1, std::memory_order_seq_cst);
+            mSleepCondition.wait(lock, [this]{
+                return mShutdown.load(std::memory_order_relaxed) || mQueued.load(std::memory_order_seq_cst) > 0;
+            });
+            mSleeping.fetch_sub(1, std::memory_order_relaxed);
+            if(mShutdown.load(std::memory_order_relaxed) && mQueued.load(std::memory_order_seq_cst) == 0)
+                break;
+        }
+
+        tJobSystem = nullptr;
+    }
+
+}//end namespace mediasystem
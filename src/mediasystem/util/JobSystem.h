@@ -0,0 +1,141 @@
+//
+//  JobSystem.h
+//  ofxMediaSystem
+//
+//  Shared executor for scenes and systems. Every worker owns a work stealing deque, jobs scheduled
+//  from a worker go onto its own deque and idle workers steal from the others. A job can depend on
+//  other jobs and only becomes runnable once all of them have finished. Jobs scheduled for the main
+//  thread are held until processMainThreadJobs(), which SceneManager calls at the start of update.
+//
+
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <initializer_list>
+#include <condition_variable>
+#include "Singleton.hpp"
+
+namespace mediasystem {
+
+    class JobSystem;
+
+    namespace detail {
+        struct Job;
+        class WorkStealingDeque;
+    }
+
+    //shared reference to a scheduled job, used to wait on it or to chain jobs after it
+    class JobHandle {
+    public:
+
+        JobHandle() = default;
+        JobHandle(const JobHandle& other);
+        JobHandle(JobHandle&& other) noexcept;
+        JobHandle& operator=(const JobHandle& other);
+        JobHandle& operator=(JobHandle&& other) noexcept;
+        ~JobHandle();
+
+        //an empty handle counts as done
+        bool isDone() const;
+        void reset();
+        explicit operator bool() const { return mJob != nullptr; }
+
+    private:
+        //adopts a reference the caller already holds
+        explicit JobHandle(detail::Job* job):mJob(job){}
+        detail::Job* mJob{nullptr};
+        friend JobSystem;
+    };
+
+    class JobSystem {
+    public:
+
+        using JobFn = std::function<void()>;
+        using RangeFn = std::function<void(size_t begin, size_t end)>;
+
+        //defaults to one worker per hardware thread, minus the main thread.
+        //The thread constructing the system is treated as the main thread.
+        explicit JobSystem(size_t numWorkers = 0);
+        //runs everything still queued before returning
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        //safe from any thread, including from inside a job
+        JobHandle schedule(JobFn fn);
+        JobHandle schedule(JobFn fn, std::initializer_list<JobHandle> dependencies);
+        JobHandle schedule(JobFn fn, const std::vector<JobHandle>& dependencies);
+
+        //continuation, runs once dependency has finished
+        JobHandle then(const JobHandle& dependency, JobFn fn);
+
+        //runs during processMainThreadJobs() once its dependencies have finished
+        JobHandle scheduleOnMainThread(JobFn fn);
+        JobHandle scheduleOnMainThread(JobFn fn, std::initializer_list<JobHandle> dependencies);
+        JobHandle scheduleOnMainThread(JobFn fn, const std::vector<JobHandle>& dependencies);
+
+        //main thread only, runs the main thread jobs that were ready on entry and returns how many ran
+        size_t processMainThreadJobs();
+
+        //Runs other jobs while waiting instead of blocking. On the main thread that includes main thread
+        //jobs, so waiting on one of those doesn't deadlock.
+        void wait(const JobHandle& job);
+        void wait(const std::vector<JobHandle>& jobs);
+
+        //Runs fn over [0, count) split into batches of at least minBatchSize and returns once every batch
+        //is done, the calling thread works on batches too. The first exception fn throws is rethrown here.
+        void parallelFor(size_t count, const RangeFn& fn, size_t minBatchSize = 1);
+
+        inline size_t getNumWorkers() const { return mWorkers.size(); }
+        size_t getNumQueuedJobs() const { return mQueued.load(std::memory_order_relaxed); }
+        size_t getNumMainThreadJobs() const;
+
+        bool isMainThread() const { return std::this_thread::get_id() == mMainThreadId; }
+        bool isWorkerThread() const;
+
+    private:
+
+        struct Worker;
+
+        static const size_t NOT_A_WORKER = static_cast<size_t>(-1);
+
+        JobHandle submit(JobFn&& fn, const JobHandle* dependencies, size_t numDependencies, bool mainThread);
+        void enqueue(detail::Job* job);
+        void run(detail::Job* job);
+        void finish(detail::Job* job);
+        detail::Job* findJob(size_t workerIndex);
+        bool runMainThreadJob();
+        bool helpOnce();
+        void workerThread(size_t index);
+        size_t currentWorkerIndex() const;
+
+        std::vector<std::unique_ptr<Worker>> mWorkers;
+
+        //jobs scheduled from outside the workers, and deque overflow
+        std::mutex mInjectedMutex;
+        std::deque<detail::Job*> mInjected;
+        std::atomic<size_t> mNumInjected{0};
+
+        mutable std::mutex mMainThreadMutex;
+        std::deque<detail::Job*> mMainThreadJobs;
+
+        std::mutex mSleepMutex;
+        std::condition_variable mSleepCondition;
+        std::atomic<size_t> mQueued{0};
+        std::atomic<size_t> mSleeping{0};
+        std::atomic<bool> mShutdown{false};
+
+        std::thread::id mMainThreadId;
+    };
+
+    //the app wide pool, SceneManager and anything that isn't handed a JobSystem use it
+    using DefaultJobSystem = Singleton<JobSystem>;
+
+}//end namespace mediasystem
@@ -0,0 +1,76 @@
+//
+//  LatencyHistogram.hpp
+//  ofxMediaSystem
+//
+//  Fixed size log2 histogram of durations, bucket i holds samples in [2^i, 2^(i+1)) microseconds.
+//
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+namespace mediasystem {
+
+    class LatencyHistogram {
+    public:
+
+        static const size_t NUM_BUCKETS = 32;
+
+        void add(std::chrono::nanoseconds duration)
+        {
+            auto micros = std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 0);
+            ++mBuckets[bucketFor(static_cast<uint64_t>(micros))];
+            ++mCount;
+            mTotalMicros += micros;
+            mMinMicros = std::min(mMinMicros, micros);
+            mMaxMicros = std::max(mMaxMicros, micros);
+        }
+
+        void reset(){ *this = LatencyHistogram(); }
+
+        uint64_t getCount() const { return mCount; }
+        int64_t getMinMicros() const { return mCount ? mMinMicros : 0; }
+        int64_t getMaxMicros() const { return mMaxMicros; }
+        double getMeanMicros() const { return mCount ? static_cast<double>(mTotalMicros) / mCount : 0.; }
+        const std::array<uint64_t, NUM_BUCKETS>& getBuckets() const { return mBuckets; }
+
+        //upper bound of the bucket holding the requested percentile [0,1]
+        int64_t getPercentileMicros(double percentile) const
+        {
+            if(mCount == 0)
+                return 0;
+            auto target = static_cast<uint64_t>(std::ceil(std::min(std::max(percentile, 0.), 1.) * mCount));
+            uint64_t seen = 0;
+            for(size_t i = 0; i < NUM_BUCKETS; i++){
+                seen += mBuckets[i];
+                if(seen >= target && mBuckets[i] > 0)
+                    return std::min<int64_t>((int64_t(1) << (i + 1)) - 1, mMaxMicros);
+            }
+            return mMaxMicros;
+        }
+
+    private:
+
+        static size_t bucketFor(uint64_t micros)
+        {
+            size_t bucket = 0;
+            while(micros > 1 && bucket < NUM_BUCKETS - 1){
+                micros >>= 1;
+                ++bucket;
+            }
+            return bucket;
+        }
+
+        std::array<uint64_t, NUM_BUCKETS> mBuckets{};
+        uint64_t mCount{0};
+        int64_t mTotalMicros{0};
+        int64_t mMinMicros{std::numeric_limits<int64_t>::max()};
+        int64_t mMaxMicros{0};
+    };
+
+}//end namespace mediasystem
@@ -0,0 +1,236 @@
+//
+//  MPSCQueue.hpp
+//  ofxMediaSystem
+//
+//  Bounded lock-free multi-producer / single-consumer ring buffer.
+//  Producers never fail because another thread happens to be touching the queue,
+//  they only have to deal with a full ring, which is handled by the OverflowPolicy.
+//
+
+#pragma once
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstddef>
+
+namespace mediasystem {
+
+    template<typename T, size_t MAX_SIZE>
+    class MPSCQueue {
+    public:
+
+        static_assert(MAX_SIZE >= 2 && (MAX_SIZE & (MAX_SIZE - 1)) == 0, "MPSCQueue MAX_SIZE must be a power of two.");
+
+        enum class OverflowPolicy {
+            BLOCK,          //producers spin until the consumer makes room
+            DROP_OLDEST,    //producers evict the oldest queued value to make room
+            GROW            //producers spill into an unbounded overflow list
+        };
+
+        explicit MPSCQueue(OverflowPolicy policy = OverflowPolicy::GROW):
+            mPolicy(policy)
+        {
+            for(size_t i = 0; i < MAX_SIZE; i++){
+                mCells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        virtual ~MPSCQueue() = default;
+
+        //non copyable
+        MPSCQueue(const MPSCQueue&) = delete;
+        MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+        //returns false only if the value could not be queued, i.e. the queue was aborted while blocking
+        bool push(const T& val)
+        {
+            T copy(val);
+            return push(std::move(copy));
+        }
+
+        bool push(T&& val)
+        {
+            bool blocked = false;
+            while(true){
+
+                if(mOverflowing.load(std::memory_order_acquire)){
+                    std::lock_guard<std::mutex> lock(mOverflowMutex);
+                    if(mOverflowing.load(std::memory_order_relaxed)){
+                        mOverflow.emplace_back(std::move(val));
+                        mOverflowCount.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+
+                if(tryEnqueue(val))
+                    return true;
+
+                //ring is full
+                switch(mPolicy.load(std::memory_order_relaxed)){
+                    case OverflowPolicy::BLOCK:{
+                        if(mAbort.load(std::memory_order_relaxed))
+                            return false;
+                        //counted once per push, not per spin
+                        if(!blocked){
+                            blocked = true;
+                            mBlockedCount.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        std::this_thread::yield();
+                    }break;
+                    case OverflowPolicy::DROP_OLDEST:{
+                        T discard;
+                        if(tryDequeue(discard)){
+                            mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }break;
+                    case OverflowPolicy::GROW:{
+                        std::lock_guard<std::mutex> lock(mOverflowMutex);
+                        mOverflowing.store(true, std::memory_order_release);
+                        mOverflow.emplace_back(std::move(val));
+                        mOverflowCount.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }break;
+                }
+            }
+        }
+
+        //consumer side only
+        bool tryPop(T& val)
+        {
+            if(tryDequeue(val))
+                return true;
+
+            if(mOverflowing.load(std::memory_order_acquire)){
+                std::lock_guard<std::mutex> lock(mOverflowMutex);
+                //a producer may have raced into the ring before the overflow flag was raised
+                if(tryDequeue(val))
+                    return true;
+                if(!mOverflow.empty()){
+                    val = std::move(mOverflow.front());
+                    mOverflow.pop_front();
+                    if(mOverflow.empty())
+                        mOverflowing.store(false, std::memory_order_release);
+                    return true;
+                }
+                mOverflowing.store(false, std::memory_order_release);
+            }
+            return false;
+        }
+
+        //approximate while producers are active
+        size_t size() const
+        {
+            auto enq = mEnqueuePos.load(std::memory_order_relaxed);
+            auto deq = mDequeuePos.load(std::memory_order_relaxed);
+            size_t ringSize = enq >= deq ? enq - deq : 0;
+            if(mOverflowing.load(std::memory_order_acquire)){
+                std::lock_guard<std::mutex> lock(mOverflowMutex);
+                ringSize += mOverflow.size();
+            }
+            return ringSize;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        void setOverflowPolicy(OverflowPolicy policy){ mPolicy = policy; }
+        OverflowPolicy getOverflowPolicy() const { return mPolicy; }
+
+        //number of values evicted by DROP_OLDEST
+        size_t getDroppedCount() const { return mDroppedCount.load(std::memory_order_relaxed); }
+        //number of values that spilled into the overflow list with GROW
+        size_t getOverflowCount() const { return mOverflowCount.load(std::memory_order_relaxed); }
+        //number of pushes that found the ring full and had to wait with BLOCK
+        size_t getBlockedCount() const { return mBlockedCount.load(std::memory_order_relaxed); }
+
+        void resetCounters()
+        {
+            mDroppedCount = 0;
+            mOverflowCount = 0;
+            mBlockedCount = 0;
+        }
+
+        //releases any producers blocked on a full queue
+        void abort()
+        {
+            mAbort = true;
+        }
+
+        //consumer side only, drains the queue and clears the abort flag
+        void reset()
+        {
+            mAbort = false;
+            T discard;
+            while(tryPop(discard)){}
+        }
+
+    private:
+
+        bool tryEnqueue(T& val)
+        {
+            auto pos = mEnqueuePos.load(std::memory_order_relaxed);
+            while(true){
+                auto& cell = mCells[pos & (MAX_SIZE - 1)];
+                auto seq = cell.sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if(diff == 0){
+                    if(mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                        cell.data = std::move(val);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }else if(diff < 0){
+                    return false; //full
+                }else{
+                    pos = mEnqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        //the consumer is the only regular caller, but DROP_OLDEST producers may race it so this must stay CAS based
+        bool tryDequeue(T& val)
+        {
+            auto pos = mDequeuePos.load(std::memory_order_relaxed);
+            while(true){
+                auto& cell = mCells[pos & (MAX_SIZE - 1)];
+                auto seq = cell.sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if(diff == 0){
+                    if(mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                        val = std::move(cell.data);
+                        cell.sequence.store(pos + MAX_SIZE, std::memory_order_release);
+                        return true;
+                    }
+                }else if(diff < 0){
+                    return false; //empty
+                }else{
+                    pos = mDequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        static const size_t CACHE_LINE = 64;
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        alignas(CACHE_LINE) std::array<Cell, MAX_SIZE> mCells;
+        alignas(CACHE_LINE) std::atomic<size_t> mEnqueuePos{0};
+        alignas(CACHE_LINE) std::atomic<size_t> mDequeuePos{0};
+
+        alignas(CACHE_LINE) std::atomic<OverflowPolicy> mPolicy;
+        std::atomic_bool mAbort{false};
+        std::atomic_bool mOverflowing{false};
+        mutable std::mutex mOverflowMutex;
+        std::deque<T> mOverflow;
+
+        std::atomic<size_t> mDroppedCount{0};
+        std::atomic<size_t> mOverflowCount{0};
+        std::atomic<size_t> mBlockedCount{0};
+    };
+
+}//end namespace mediasystem
@@ -162,24 +162,24 @@ namespace mediasystem {
         };
         
         using KeyFrameCallback = std::function<void(State&)>;
+        //0 for keyframes added through Options, those can only be cleared
+        using KeyFrameId = size_t;
         struct KeyFrame {
-            KeyFrame(T pos, KeyFrameCallback cb):
+            KeyFrame(T pos, KeyFrameCallback cb, KeyFrameId kfId = 0):
             position(pos),
-            callback(std::move(cb))
+            callback(std::move(cb)),
+            id(kfId)
             {}
             T position;
             KeyFrameCallback callback;
+            KeyFrameId id;
         };
         
-        static void insertKeyframe(KeyFrame&& keyframe, std::list<KeyFrame>& keyframes){
+        static typename std::list<KeyFrame>::iterator insertKeyframe(KeyFrame&& keyframe, std::list<KeyFrame>& keyframes){
             auto found = std::find_if(keyframes.begin(), keyframes.end(), [&keyframe](const KeyFrame& kf){
                 return kf.position > keyframe.position;
             });
-            if(found != keyframes.end()){
-                keyframes.emplace(found, std::move(keyframe));
-            }else{
-                keyframes.emplace_back(std::move(keyframe));
-            }
+            return keyframes.emplace(found, std::move(keyframe));
         }
         
         class Options {
@@ -328,8 +328,40 @@ namespace mediasystem {
             mCurrentKeyFrame = mKeyFrames.begin();
         }
         
-        virtual void setKeyFrame(T position, KeyFrameCallback callback){
-            insertKeyframe(KeyFrame(position, std::move(callback)), mKeyFrames);
+        //A keyframe still ahead of the playhead fires on this pass, one behind it waits for the next loop.
+        //Returns the id removeKeyFrame() takes.
+        virtual KeyFrameId setKeyFrame(T position, KeyFrameCallback callback){
+            auto inserted = insertKeyframe(KeyFrame(position, std::move(callback), ++mNextKeyFrameId), mKeyFrames);
+            bool ahead;
+            if(mState.isReversed()){
+                //equal positions are inserted after the existing ones, so they come first walking backwards
+                ahead = position <= mState.currentPosition && (mCurrentKeyFrame == mKeyFrames.end() || position >= mCurrentKeyFrame->position);
+            }else{
+                ahead = position >= mState.currentPosition && (mCurrentKeyFrame == mKeyFrames.end() || position < mCurrentKeyFrame->position);
+            }
+            if(ahead){
+                mCurrentKeyFrame = inserted;
+            }
+            return inserted->id;
+        }
+        
+        //not from inside a keyframe callback, returns false if there is no such keyframe
+        virtual bool removeKeyFrame(KeyFrameId id){
+            auto found = std::find_if(mKeyFrames.begin(), mKeyFrames.end(), [id](const KeyFrame& kf){
+                return kf.id == id;
+            });
+            if(id == 0 || found == mKeyFrames.end()){
+                return false;
+            }
+            if(found == mCurrentKeyFrame){
+                if(mState.isReversed()){
+                    mCurrentKeyFrame = found == mKeyFrames.begin() ? mKeyFrames.end() : std::prev(found);
+                }else{
+                    mCurrentKeyFrame = std::next(found);
+                }
+            }
+            mKeyFrames.erase(found);
+            return true;
         }
         
         virtual void step(T amount){
@@ -546,6 +578,7 @@ namespace mediasystem {
         State mState;
         std::list<KeyFrame> mKeyFrames;
         typename std::list<KeyFrame>::iterator mCurrentKeyFrame;
+        KeyFrameId mNextKeyFrameId{0};
         //todo, think about the allocation strategy here?
         std::map<Handler,std::function<void()>> mHandlersMap;
         std::vector<std::pair<Handler,std::function<void()>>> mUpdateHandlerQueue;
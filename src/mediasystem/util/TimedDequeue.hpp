@@ -0,0 +1,74 @@
+//
+//  TimedDequeue.hpp
+//  ofxMediaSystem
+//
+//  Shared drain loop for TimedQueue, TimedLockingQueue and TimedMPSCQueue.
+//
+
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+
+namespace mediasystem {
+
+    namespace detail {
+
+        static const size_t MAX_DEQUEUE_SAMPLE_INTERVAL = 64;
+
+        //Pops and handles values until the queue is empty, the handler returns false, or the budget is spent.
+        //A negative budget means no limit. The clock is not read per value: after each sample the interval
+        //to the next one is sized from the measured per-value cost so that it lands about halfway into
+        //the remaining budget. Returns the number of values handled.
+        template<typename T, typename PopFn, typename Handler>
+        size_t timedDequeue(PopFn&& pop, Handler& handler, std::chrono::microseconds budget)
+        {
+            using clock = std::chrono::steady_clock;
+
+            T val;
+            size_t count = 0;
+
+            if(budget.count() < 0){
+                while(pop(val)){
+                    ++count;
+                    if(handler && !handler(val))
+                        break;
+                }
+                return count;
+            }
+
+            if(budget.count() == 0)
+                return 0;
+
+            auto start = clock::now();
+            size_t nextSample = 1;
+            while(pop(val)){
+                ++count;
+                if(handler && !handler(val))
+                    break;
+                if(count == nextSample){
+                    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+                    if(elapsed >= budget)
+                        break;
+                    auto perValue = std::max<double>(static_cast<double>(elapsed.count()) / count, 0.01);
+                    auto fits = static_cast<size_t>(static_cast<double>((budget - elapsed).count()) / perValue / 2.);
+                    nextSample = count + std::min(std::max<size_t>(fits, 1), MAX_DEQUEUE_SAMPLE_INTERVAL);
+                }
+            }
+            return count;
+        }
+
+        inline std::chrono::microseconds dequeueBudgetFromMs(int maxMs)
+        {
+            return maxMs < 0 ? std::chrono::microseconds(-1) : std::chrono::microseconds(static_cast<int64_t>(maxMs) * 1000);
+        }
+
+        inline int dequeueBudgetToMs(std::chrono::microseconds budget)
+        {
+            return budget.count() < 0 ? -1 : static_cast<int>(budget.count() / 1000);
+        }
+
+    }//end namespace detail
+
+}//end namespace mediasystem
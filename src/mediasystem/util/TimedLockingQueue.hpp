@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <functional>
 #include "LockingQueue.hpp"
+#include "TimedDequeue.hpp"
 
 namespace mediasystem {
 
@@ -21,67 +23,24 @@ namespace mediasystem {
         using DequeueHandler = std::function<bool(T&)>;
         
         explicit TimedLockingQueue(DequeueHandler handler, int maxDequeueTime = NO_TIME_LIMIT):
-            mMaxDequeueTime(maxDequeueTime),
+            mMaxDequeueTime(detail::dequeueBudgetFromMs(maxDequeueTime)),
             mHandler(handler)
         {}
         
         virtual ~TimedLockingQueue() = default;
         
-        inline void dequeue(){
-            T val;
-            auto start = std::chrono::high_resolution_clock::now();
-            int elapsed = 0;
-            int count = 0;
-            if(mMaxDequeueTime < 0){
-                while(true){
-                    auto success = LockingQueue<T, MAX_SIZE>::tryPop(val);
-                    if(success){
-                        ++count;
-                        bool ret = true;
-                        if(mHandler){
-                            ret = mHandler(val);
-                        }
-                        if(!ret)
-                            break;
-                    }else{
-                        if(count > 0){
-                            elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
-                        }
-                        break;
-                    }
-                    elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
-                }
-            }else{
-                while(true){
-                    if(elapsed >= mMaxDequeueTime){
-                        break;
-                    }
-                    auto success = LockingQueue<T, MAX_SIZE>::tryPop(val);
-                    if(success){
-                        ++count;
-                        bool ret = true;
-                        if(mHandler){
-                            ret = mHandler(val);
-                        }
-                        if(!ret)
-                            break;
-                    }else{
-                        if(count > 0){
-                            elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
-                        }
-                        break;
-                    }
-                    elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
-                }
-            }
+        //handles queued values until the queue is empty or the max dequeue time is spent, returns the number handled
+        inline size_t dequeue(){
+            return detail::timedDequeue<T>([this](T& val){ return LockingQueue<T, MAX_SIZE>::tryPop(val); }, mHandler, mMaxDequeueTime);
         }
         
-        inline void setMaxDequeueTime( int maxMs ){ mMaxDequeueTime = maxMs; }
-        inline int getMaxDequeueTime() const { return mMaxDequeueTime; }
+        inline void setMaxDequeueTime( int maxMs ){ mMaxDequeueTime = detail::dequeueBudgetFromMs(maxMs); }
+        inline void setMaxDequeueTime( std::chrono::microseconds maxTime ){ mMaxDequeueTime = maxTime; }
+        inline int getMaxDequeueTime() const { return detail::dequeueBudgetToMs(mMaxDequeueTime); }
 
     protected:
         
-        int mMaxDequeueTime{NO_TIME_LIMIT};
+        std::chrono::microseconds mMaxDequeueTime{NO_TIME_LIMIT};
         DequeueHandler mHandler;
     };
 
@@ -0,0 +1,49 @@
+//
+//  TimedMPSCQueue.hpp
+//  ofxMediaSystem
+//
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <functional>
+#include "MPSCQueue.hpp"
+#include "TimedDequeue.hpp"
+
+namespace mediasystem {
+
+    template<typename T, size_t MAX_SIZE>
+    class TimedMPSCQueue : public MPSCQueue<T, MAX_SIZE>{
+    public:
+        
+        static const int NO_TIME_LIMIT = -1;
+
+        using Ref = std::shared_ptr<TimedMPSCQueue>;
+        using OverflowPolicy = typename MPSCQueue<T, MAX_SIZE>::OverflowPolicy;
+        using DequeueHandler = std::function<bool(T&)>;
+        
+        explicit TimedMPSCQueue(DequeueHandler handler, int maxDequeueTime = NO_TIME_LIMIT, OverflowPolicy policy = OverflowPolicy::GROW):
+            MPSCQueue<T, MAX_SIZE>(policy),
+            mMaxDequeueTime(detail::dequeueBudgetFromMs(maxDequeueTime)),
+            mHandler(handler)
+        {}
+        
+        virtual ~TimedMPSCQueue() = default;
+        
+        //handles queued values until the queue is empty or the max dequeue time is spent, returns the number handled
+        inline size_t dequeue(){
+            return detail::timedDequeue<T>([this](T& val){ return MPSCQueue<T, MAX_SIZE>::tryPop(val); }, mHandler, mMaxDequeueTime);
+        }
+        
+        inline void setMaxDequeueTime( int maxMs ){ mMaxDequeueTime = detail::dequeueBudgetFromMs(maxMs); }
+        inline void setMaxDequeueTime( std::chrono::microseconds maxTime ){ mMaxDequeueTime = maxTime; }
+        inline int getMaxDequeueTime() const { return detail::dequeueBudgetToMs(mMaxDequeueTime); }
+
+    protected:
+        
+        std::chrono::microseconds mMaxDequeueTime{NO_TIME_LIMIT};
+        DequeueHandler mHandler;
+    };
+
+}//end namespace media system
@@ -8,6 +8,9 @@
 #pragma once
 
 #include <deque>
+#include <memory>
+#include <functional>
+#include "TimedDequeue.hpp"
 
 namespace mediasystem {
 
@@ -21,63 +24,20 @@ namespace mediasystem {
         using DequeueHandler = std::function<bool(T&)>;
         
         explicit TimedQueue(DequeueHandler handler, int maxDequeueTime = NO_TIME_LIMIT):
-            mMaxDequeueTime(maxDequeueTime),
+            mMaxDequeueTime(detail::dequeueBudgetFromMs(maxDequeueTime)),
             mHandler(handler)
         {}
         
         virtual ~TimedQueue() = default;
         
-        inline void dequeue(){
-            T val;
-            auto start = std::chrono::high_resolution_clock::now();
-            int elapsed = 0;
-            int count = 0;
-            if(mMaxDequeueTime < 0){
-                while(true){
-                    auto success = pop(val);
-                    if(success){
-                        ++count;
-                        bool ret = true;
-                        if(mHandler){
-                            ret = mHandler(val);
-                        }
-                        if(!ret)
-                            break;
-                    }else{
-                        if(count > 0){
-                            elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
-                        }
-                        break;
-                    }
-                    elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
-                }
-            }else{
-                while(true){
-                    if(elapsed >= mMaxDequeueTime){
-                        break;
-                    }
-                    auto success = pop(val);
-                    if(success){
-                        ++count;
-                        bool ret = true;
-                        if(mHandler){
-                            ret = mHandler(val);
-                        }
-                        if(!ret)
-                            break;
-                    }else{
-                        if(count > 0){
-                            elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
-                        }
-                        break;
-                    }
-                    elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
-                }
-            }
+        //handles queued values until the queue is empty or the max dequeue time is spent, returns the number handled
+        inline size_t dequeue(){
+            return detail::timedDequeue<T>([this](T& val){ return pop(val); }, mHandler, mMaxDequeueTime);
         }
         
-        inline void setMaxDequeueTime( int maxMs ){ mMaxDequeueTime = maxMs; }
-        inline int getMaxDequeueTime() const { return mMaxDequeueTime; }
+        inline void setMaxDequeueTime( int maxMs ){ mMaxDequeueTime = detail::dequeueBudgetFromMs(maxMs); }
+        inline void setMaxDequeueTime( std::chrono::microseconds maxTime ){ mMaxDequeueTime = maxTime; }
+        inline int getMaxDequeueTime() const { return detail::dequeueBudgetToMs(mMaxDequeueTime); }
         
         inline void push(T&& val)
         {
@@ -92,6 +52,9 @@ namespace mediasystem {
         void clear(){
             mQueue.clear();
         }
+        
+        inline size_t size() const { return mQueue.size(); }
+        inline bool empty() const { return mQueue.empty(); }
 
     protected:
         
@@ -104,7 +67,7 @@ namespace mediasystem {
             return true;
         }
         
-        int mMaxDequeueTime{NO_TIME_LIMIT};
+        std::chrono::microseconds mMaxDequeueTime{NO_TIME_LIMIT};
         DequeueHandler mHandler;
         std::deque<T> mQueue;
         
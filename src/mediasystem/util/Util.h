@@ -11,6 +11,10 @@
 #include "Profiler.hpp"
 #include "RandString.hpp"
 #include "TimedLockingQueue.hpp"
+#include "MPSCQueue.hpp"
+#include "TimedMPSCQueue.hpp"
+#include "LatencyHistogram.hpp"
+#include "JobSystem.h"
 #include "Manager.hpp"
 #include "StateMachine.h"
 #include "MemberDetection.hpp"